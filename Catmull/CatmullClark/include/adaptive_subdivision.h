@@ -0,0 +1,94 @@
+#ifndef ADAPTIVE_SUBDIVISION_H
+#define ADAPTIVE_SUBDIVISION_H
+
+#include "common_defines.h"
+#include "topology.h"
+
+// Where a face of some refinement level lies on the cage: cell (x, y) of the 2^level x 2^level grid
+// over the (u, v) domain of the cage face. Children keep the orientation of their parent face.
+struct FaceOrigin {
+	int face;
+	int level;
+	Vec2i cell;
+
+public:
+	FaceOrigin child(int j) const { return { face, level + 1, 2 * cell + Vec2i(j == 1 || j == 2, j >= 2) }; }
+};
+
+// Uniform cubic B-spline basis functions at t, and their derivatives
+inline Vec4 bsplineBasis(float t) {
+	const float s = 1.f - t;
+	return {
+		s * s * s / 6.f,
+		(3.f * t * t * t - 6.f * t * t + 4.f) / 6.f,
+		(-3.f * t * t * t + 3.f * t * t + 3.f * t + 1.f) / 6.f,
+		t * t * t / 6.f,
+	};
+}
+
+inline Vec4 bsplineDerivBasis(float t) {
+	const float s = 1.f - t;
+	return {
+		-0.5f * s * s,
+		1.5f * t * t - 2.f * t,
+		-1.5f * t * t + t + 0.5f,
+		0.5f * t * t,
+	};
+}
+
+// Uniform bicubic B-spline patch, the exact limit surface of a face with four regular vertices.
+// Control points are row major, cps[4 * row + col]. The face spans the inner ones: its vertices 0..3
+// are cps 5, 6, 10, 9, u runs from vertex 0 to vertex 1 and v from vertex 0 to vertex 3.
+struct BSplinePatch {
+	Vec3 cps[16];
+	FaceOrigin origin; // origin.level is the refinement level the patch was found at
+
+public:
+	Vec3 evaluate(float u, float v) const;
+	Vec3 evaluate(float u, float v, Vec3 &du, Vec3 &dv) const;
+};
+
+// One level of a partial refinement: the faces still being refined and the one-ring around them.
+struct AdaptiveLevel {
+	Vec<Vec3> ps;
+	Vec<Vec4i> faces;
+	Topology topology;
+	Vec<char> owned; // 1 if the face and its one-ring have their exact positions at this level
+	Vec<FaceOrigin> origins;
+};
+
+enum FaceKind : char {
+	FACE_SKIP, // Not owned, only there as a neighbor
+	FACE_PATCH,
+	FACE_REFINE,
+	FACE_FINAL, // Irregular at the last level
+};
+
+// Next level made of the FACE_REFINE faces and their one-ring. Children of refined faces are owned,
+// the ones of the ring are only there so that the owned faces have their full neighborhood.
+void refineAround(const AdaptiveLevel &lvl, const Vec<char> &kind, AdaptiveLevel &next);
+
+// Feature-adaptive Catmull-Clark refinement of a cage.
+// A face whose vertices are all regular is emitted as a patch as soon as it is found, only the faces
+// around extraordinary vertices and boundaries are refined further. Faces still irregular at the
+// last level are kept as quads with their vertices pushed to the limit surface.
+struct AdaptiveMesh {
+	int levels = 0;
+	Vec<BSplinePatch> patches;
+	Vec<Vec3> ps; // Vertices of the irregular faces
+	Vec<Vec3> normals; // Limit normals of ps
+	Vec<Vec4i> faces; // Irregular faces of the last level
+	Vec<FaceOrigin> faceOrigins; // One per irregular face
+
+public:
+	void build(const Vec<Vec3> &cagePs, const Vec<Vec4i> &cageFaces, int levels);
+
+	// Quads of all patches and irregular faces, with the limit normal of each vertex.
+	// A patch found at level l is split in (rate << (levels - l))^2 quads, so for rate 1 the result samples the limit surface at the vertices of the uniform subdivision.
+	// Irregular faces stay single quads, so the rate used is patchRate(rate): patches next to them would leave T-junctions otherwise.
+	void tessellate(int rate, Vec<Vec3> &outPs, Vec<Vec3> &outNormals, Vec<Vec4i> &outFaces) const;
+	// Rate tessellate uses for the asked one, 1 while there are irregular faces
+	int patchRate(int rate) const { return faces.empty() ? Max(1, rate) : 1; }
+};
+
+#endif // ADAPTIVE_SUBDIVISION_H
@@ -0,0 +1,53 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include "common_defines.h"
+
+// Time to refine a cage to level with each SubdivisionEngine, best of the repeats.
+// Triangulation and the limit pass are left out, they are the same for both.
+struct EngineTimings {
+	int level = 0;
+	double globalMs = 0.0;
+	double tiledMs = 0.0;
+};
+
+EngineTimings benchmarkEngines(const Vec<Vec3> &cagePs, const Vec<Vec4i> &cageFaces, int level, int repeats = 3);
+
+// A level refined from the cage as it comes and with its vertices sorted along the Morton curve
+// at every level, see spatial_order.h. Compares the next subdivision step from each and the
+// cache lines missed fetching vertex positions when drawn, per triangle through a 32 KB 4-way cache.
+struct OrderTimings {
+	int level = 0;
+	double plainMs = 0.0; // next step from the level in refinement order
+	double orderedMs = 0.0; // next step from the sorted level
+	double reorderMs = 0.0; // sorting the next level
+	float plainFetchMisses = 0.f;
+	float orderedFetchMisses = 0.f;
+};
+
+OrderTimings benchmarkSpatialOrder(const Vec<Vec3> &cagePs, const Vec<Vec4i> &cageFaces, int level, int repeats = 3);
+
+// Refining a cage to level level by level as a mesh does, once computing the connectivity of every
+// level and once taking it from a RefinementTopology refined beforehand, as a second mesh with the
+// same cage faces would. Both include the triangles of every level.
+struct SharedTopologyTimings {
+	int level = 0;
+	double ownMs = 0.0;
+	double sharedMs = 0.0;
+};
+
+SharedTopologyTimings benchmarkSharedTopology(const Vec<Vec3> &cagePs, const Vec<Vec4i> &cageFaces, int level, int repeats = 3);
+
+// Reading a cage file with importCage, and through iostreams a line or a value at a time as loaders
+// usually do. match tells whether both read the same cage, points within float rounding.
+struct ImportTimings {
+	double mappedMs = 0.0;
+	double streamMs = 0.0;
+	int vertCount = 0;
+	int faceCount = 0; // quads and polygons
+	bool match = false;
+};
+
+ImportTimings benchmarkImport(const char *path, int repeats = 3);
+
+#endif // BENCHMARK_H
@@ -25,6 +25,24 @@ T Min(const T& a, const T& b) {
 template <class T>
 using Vec = std::vector<T>;
 
+// Memory held by a vector
+template <class T>
+size_t bytesOf(const Vec<T> &v) {
+	return v.capacity() * sizeof(T);
+}
+
+// Size n, growing to a capacity of exactly n. Buffers reused from level to level then never
+// hold more than the largest level, which resize's doubling would not give.
+// The contents are not kept when v grows, they are all to be overwritten.
+template <class T>
+void resizeExact(Vec<T> &v, size_t n) {
+	if (v.capacity() < n) {
+		Vec<T>(n).swap(v);
+	} else {
+		v.resize(n);
+	}
+}
+
 template <class T>
 using Set = std::unordered_set<T>;
 
@@ -41,6 +59,7 @@ using Vec4i = glm::vec<4, int>;
 template <int N>
 using VecNi = glm::vec<N, int>;
 
+using Vec2 = glm::vec<2, float>;
 using Vec3 = glm::vec<3, float>;
 using Vec4 = glm::vec<4, float>;
 
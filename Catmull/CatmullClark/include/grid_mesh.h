@@ -0,0 +1,43 @@
+#ifndef GRID_MESH_H
+#define GRID_MESH_H
+
+#include "common_defines.h"
+#include "tiled_subdivision.h"
+#include "topology.h"
+
+// Triangles of a (2^level + 1)^2 grid of points, row major, two per quad split as triangulate does
+void gridIndices(int level, Vec<unsigned int> &indices);
+
+// Uniform level of a quad cage kept as a (2^level + 1)^2 grid of points per cage face instead of
+// explicit quads and triangles. The points are numbered as in CageGrid with slot f for cage face f,
+// so a point on a cage edge or vertex is stored once and the cage topology tells where it is.
+// Quads follow from (face, x, y) and every patch draws with the same index buffer.
+struct GridMesh {
+	int level = -1; // -1 if empty
+	Vec<Vec4i> cageFaces;
+	Topology cage;
+	Vec<int> slots; // f for cage face f
+
+public:
+	void init(const Vec<Vec4i> &faces, size_t cageVertCount, int lvl);
+	void clear();
+	bool empty() const { return level < 0; }
+
+	CageGrid grid() const; // points into this, valid as long as it is not changed
+	int patchSize() const { return (1 << level) + 1; } // Points per patch edge
+	long long vertCount() const { return grid().vertCount(); }
+	long long quadCount() const { return grid().quadCount(); }
+
+	// Index of point (x, y) of cage face f in the shared points
+	int vertex(int f, int x, int y) const;
+	// Explicit quads of the level, the same as those of tiledSubdivide
+	void quads(Vec<Vec4i> &faces) const;
+	// Triangles over the patchSize()^2 points of one patch, see gridIndices
+	void patchIndices(Vec<unsigned int> &indices) const { gridIndices(level, indices); }
+	// Points of cage face f in patch order, out holds patchSize()^2 of them
+	void patchPoints(const Vec<Vec3> &ps, int f, Vec3 *out) const;
+
+	size_t bytes() const;
+};
+
+#endif // GRID_MESH_H
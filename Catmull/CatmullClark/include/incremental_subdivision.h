@@ -0,0 +1,28 @@
+#ifndef INCREMENTAL_SUBDIVISION_H
+#define INCREMENTAL_SUBDIVISION_H
+
+#include "common_defines.h"
+#include "topology.h"
+
+// Local updates of a chain of uniform levels after some cage vertices moved. A moved vertex
+// only changes the vertices of its one-ring one level down, so the changed region is carried
+// from level to level instead of refining everything again.
+
+// Vertices of the faces around the vertices of dirty, sorted. These are the vertices whose
+// vertex point or limit reads a vertex of dirty.
+void vertexRing(const Vec<Vec4i> &faces, const Topology &topology, const Vec<int> &dirty, Vec<int> &ring);
+
+// Child vertices of the next level that read a vertex of dirty, sorted and numbered as in
+// Mesh::subdivide: vertex points of the ring, face points and edge points of the faces around.
+void dirtyChildren(const Vec<Vec4i> &faces, const Topology &topology, const Vec<int> &dirty, Vec<int> &children);
+
+// Recompute the child vertices children of the next level from the parent points ps.
+// Child c is at childPs[order[c]] if the level was reordered, at childPs[c] if order is empty.
+void refineVertices(const Vec<Vec4i> &faces, const Topology &topology, const Vec<Vec3> &ps, const Vec<int> &children,
+	const Vec<int> &order, Vec<Vec3> &childPs);
+
+// Merge the sorted vertices verts into the [begin, end) ranges of ranges. Ranges closer than
+// a few vertices are joined, one upload call costs more than a few extra bytes.
+void addDirtyRanges(const Vec<int> &verts, Vec<Vec2i> &ranges);
+
+#endif // INCREMENTAL_SUBDIVISION_H
@@ -0,0 +1,42 @@
+#ifndef LIMIT_EVALUATOR_H
+#define LIMIT_EVALUATOR_H
+
+#include "common_defines.h"
+
+// A point of the limit surface: (u, v) in [0, 1]^2 over cage face `face`,
+// u runs from face vertex 0 to vertex 1 and v from vertex 0 to vertex 3.
+struct LimitQuery {
+	int face;
+	float u;
+	float v;
+};
+
+// Evaluates the limit surface of a cage at any (face, u, v) without refining the whole mesh.
+// Regular regions are B-spline patches from the adaptive refinement and are exact. Around
+// extraordinary vertices and boundaries the patches go down to `depth` levels, the cells left
+// there interpolate their limit corners, so the error there shrinks with 4^-depth.
+struct LimitEvaluator {
+	int depth = -1; // -1 until built
+	Vec<Vec4> patchCps; // 16 control points per patch, padded to 4 floats for SSE
+	Vec<int> patchLevels;
+	Vec<Vec4> cellCorners; // 4 limit positions per irregular cell
+	Vec<int> cellLevels;
+
+	// Quadtree over each cage face. An entry >= 0 is an inner node, ~i a leaf:
+	// patch i for i < patch count, irregular cell i - patch count after that.
+	Vec<int> roots;
+	Vec<Vec4i> nodes;
+
+public:
+	void build(const Vec<Vec3> &cagePs, const Vec<Vec4i> &cageFaces, int depth = 6);
+	bool built() const { return depth >= 0; }
+
+	// Position, and derivatives along u and v if du and dv are given
+	Vec3 evaluate(int face, float u, float v, Vec3 *du = nullptr, Vec3 *dv = nullptr) const;
+	Vec3 evaluate(const LimitQuery &query, Vec3 *du = nullptr, Vec3 *dv = nullptr) const;
+
+	// Batch version, parallel and SIMD. du and dv may be null.
+	void evaluate(const Vec<LimitQuery> &queries, Vec<Vec3> &ps, Vec<Vec3> *du = nullptr, Vec<Vec3> *dv = nullptr) const;
+};
+
+#endif // LIMIT_EVALUATOR_H
@@ -0,0 +1,22 @@
+#ifndef LIMIT_SURFACE_H
+#define LIMIT_SURFACE_H
+
+#include "common_defines.h"
+#include "topology.h"
+
+// Exact limit position of vertex v of a subdivision level. Reads the one-ring of v only.
+Vec3 limitPosition(const Vec<Vec4i> &faces, const Topology &topology, const Vec<Vec3> &ps, int v);
+
+// Unit limit normal of vertex v, facing the side the faces wind counterclockwise around.
+// Interior vertices use the valence dependent tangent masks. On boundaries the tangent along
+// the border is exact and the normal is the face normal sum made orthogonal to it.
+Vec3 limitNormal(const Vec<Vec4i> &faces, const Topology &topology, const Vec<Vec3> &ps, int v);
+
+// Push every vertex of a level to its limit position and compute its limit normal. Parallel.
+void limitProject(const Vec<Vec4i> &faces, const Topology &topology, const Vec<Vec3> &ps, Vec<Vec3> &limitPs, Vec<Vec3> &normals);
+
+// Same for the vertices verts only, limitPs and normals already hold the others
+void limitProjectVertices(const Vec<Vec4i> &faces, const Topology &topology, const Vec<Vec3> &ps, const Vec<int> &verts,
+	Vec<Vec3> &limitPs, Vec<Vec3> &normals);
+
+#endif // LIMIT_SURFACE_H
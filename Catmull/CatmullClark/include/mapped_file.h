@@ -0,0 +1,37 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+// C std
+#include <cstddef>
+
+// A file mapped in memory. The OS pages it in and writes it back, so files larger than the RAM
+// can be read and written through plain pointers.
+struct MappedFile {
+	char *data = nullptr;
+	size_t size = 0;
+	bool writable = false;
+
+#ifdef _WIN32
+	void *file = nullptr;
+	void *mapping = nullptr;
+#else
+	int fd = -1;
+#endif
+
+public:
+	MappedFile() = default;
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	~MappedFile();
+
+	bool create(const char *path, size_t size); // Read-write, the file is created or truncated to size
+	bool open(const char *path); // Read-only
+	void close();
+	bool isOpen() const { return data != nullptr; }
+
+	// Hand the pages of [offset, offset + bytes) back to the OS, written ones are flushed first.
+	// Keeps the working set constant while walking a large file once.
+	void release(size_t offset, size_t bytes);
+};
+
+#endif // MAPPED_FILE_H
@@ -1,7 +1,35 @@
 #ifndef MESH_H
 #define MESH_H
 
+// C++ std
+#include <memory>
+
+#include "adaptive_subdivision.h"
 #include "common_defines.h"
+#include "grid_mesh.h"
+#include "limit_evaluator.h"
+#include "mesh_export.h"
+#include "stencil_table.h"
+#include "subdivision_job.h"
+#include "topology.h"
+#include "topology_cache.h"
+
+// A subdivision level put aside by Mesh, see Mesh::setLevel
+struct CachedLevel {
+	unsigned int version = 0; // Mesh::version of the data, 0 if the slot is empty
+	Vec<Vec3> ps;
+	Vec<Vec3i> triFaces;
+	Vec<Vec4i> faces;
+	Topology topology;
+	Vec<Vec3> limitPs;
+	Vec<Vec3> normals;
+	Vec<int> vertOrder;
+	GridMesh grid;
+	std::shared_ptr<const TopologyLevel> sharedLevel; // See Mesh::sharedLevel
+
+public:
+	size_t bytes() const; // The shared connectivity excluded
+};
 
 struct Mesh {
 	static const int TRI_FACE_VERTS = 3;
@@ -10,17 +38,150 @@ struct Mesh {
 	Vec<Vec3> ps; // Vertices
 	Vec<Vec3i> triFaces; // Triangular faces
 	Vec<Vec4i> faces; // Quadrangular faces
-	bool subdivided = false; // True iff the mesh was subdivided
+	bool subdivided = false; // True iff the current level was replaced since the last upload
+	bool pointsMoved = false; // True iff only the vertex positions changed since the last upload
+	Vec<Vec2i> dirtyRanges; // [begin, end) ranges of points() that moved, valid with pointsMoved
+
+	Topology topology; // Connectivity of the current level. Refined together with the faces.
+	int level = 0; // Number of subdivisions applied to the cage
+	SubdivisionEngine engine = SubdivisionEngine::Global; // How uniform levels are computed
+
+	// Vertices of the uniform levels of the global engine sorted along a Morton curve after
+	// refinement, see spatial_order.h. vertOrder[c] is then where child vertex c went, empty otherwise.
+	bool spatialOrder = false;
+	Vec<int> vertOrder;
+
+	// Uniform levels of the tiled engine kept as one grid of points per cage face, see grid_mesh.h.
+	// faces, triFaces and topology are empty at such a level and it is drawn without limit projection.
+	bool gridStorage = false;
+	GridMesh grid; // Empty unless the current level is a grid
+
+	// Connectivity of the uniform levels of the global engine taken from the meshes sharing the
+	// cage faces, see topology_cache.h. A step then only computes the points. Not with reordering.
+	// Such a level refers to its TopologyLevel in sharedLevel, faces, triFaces and topology stay
+	// empty then. quads() and triangles() are those of the current level either way.
+	bool shareTopology = false;
+	std::shared_ptr<RefinementTopology> refinement; // Set on the first step that uses it
+	std::shared_ptr<const TopologyLevel> sharedLevel; // Holds its refinement, null for a level of its own
+
+	// Base level, saved on the first subdivision. Level 0 uses ps and faces directly.
+	Vec<Vec3> cagePs;
+	Vec<Vec4i> cageFaces;
+	StencilTable stencils; // Current level as weights on the cage, built on the first cage edit
+
+	// Adaptive mode refines only around extraordinary vertices and boundaries and tessellates
+	// the regular regions from their patches. ps and faces then hold the tessellation.
+	bool adaptiveMode = false;
+	int patchRate = 1; // Quads per patch edge and level, see AdaptiveMesh::tessellate
+	AdaptiveMesh adaptive;
+
+	// Final pass that renders the limit positions of ps with analytic normals, see limit_surface.h.
+	// The adaptive tessellation is on the limit already.
+	bool limitProjection = false;
+	Vec<Vec3> limitPs;
+	Vec<Vec3> normals; // Normals of points(), empty when there are none
+
+	LimitEvaluator evaluator; // Limit surface of the cage, built on first use
+
+	// Every level computed so far stays in levelCache[level] once the mesh leaves it, so going
+	// back and forth between levels is only a swap. The renderer keeps its buffers per level
+	// and per version, a level coming back with the same version is not uploaded again.
+	unsigned int version = 1; // Changes whenever the data of the current level changes
+	unsigned int lastVersion = 1;
+	int maxLevel = 0; // Highest level computed so far
+	Vec<CachedLevel> levelCache;
+	size_t cacheBudget = size_t(1) << 30; // Bytes the cached levels may take, the current one excluded
+
+	// Subdivision running on its own thread, see subdivideAsync. Cancelled jobs are kept
+	// until they reach the end of their current stage.
+	std::unique_ptr<SubdivisionJob> job;
+	Vec<std::unique_ptr<SubdivisionJob>> cancelledJobs;
+
+	// Memory handed from step to step: the kernel temporaries and the largest level dropped from
+	// the cache, whose buffers the next step writes into. A level rebuilt after its eviction then
+	// reuses the memory it had instead of allocating.
+	SubdivisionScratch scratch;
+	CachedLevel spare;
+
+	// Phases of the last computation of each level and of its upload, see subdivision_profile.h
+	SubdivisionProfile profile;
 
 public:
-	void importMesh() { __TODO__ }
+	// Replace the cage with the one of an OBJ or PLY file, see mesh_import.h. Faces other than quads are
+	// refined once with the quads so the cage is all quads. Returns false and keeps the mesh if it cannot be read.
+	bool importMesh(const char *path);
+	// Write the current level, see mesh_export.h. PLY for .ply, the native format otherwise.
+	bool exportLevel(const char *path, ExportStats *stats = nullptr) const;
 	void subdivide();
 
+	// Start the next level on a worker thread, the current one stays as it is meanwhile.
+	// pollSubdivision swaps the result in once it is there and returns true then.
+	// Any other change of the mesh cancels the job.
+	void subdivideAsync();
+	bool pollSubdivision();
+	void cancelSubdivision();
+	const SubdivisionJob* subdivisionJob() const; // Null when none runs
+
+	int cageVertCount() const;
+	Vec3 cageVertex(int i) const;
+	const Vec<Vec3>& cagePoints() const;
+	const Vec<Vec4i>& cageQuads() const;
+	// Move a cage vertex. Uniform levels are updated around the vertex only, the current one and the
+	// cached ones, as long as they chain down to the cage. Otherwise the current level is evaluated
+	// again from the stencils and the cache is dropped. Topology is untouched.
+	void setCageVertex(int i, const Vec3 &p);
+
+	// Switch between uniform and adaptive refinement, the current level is rebuilt from the cage.
+	void setAdaptive(bool on);
+	// Switch the engine of uniform levels, the current level is rebuilt from the cage.
+	// The engines number the vertices differently, the surfaces are the same.
+	void setEngine(SubdivisionEngine e);
+	// Switch the reordering of uniform levels, the current level is rebuilt from the cage.
+	void setSpatialOrder(bool on);
+	// Switch the grid storage of tiled levels, the current level is rebuilt from the cage.
+	void setGridStorage(bool on);
+	// The numbering is the same either way, the levels are kept
+	void setShareTopology(bool on);
+	bool gridLevels() const { return gridStorage && engine == SubdivisionEngine::Tiled && !adaptiveMode; }
+	void setPatchRate(int rate);
+	void setLimitProjection(bool on);
+
+	// Show level l, from the cache if it is there. Missing levels are refined from the nearest one below.
+	void setLevel(int l);
+	void setCacheBudget(size_t bytes);
+	unsigned int cachedVersion(int l) const; // 0 if level l is not cached
+	size_t cacheBytes() const;
+	size_t levelBytes() const; // Memory of the current level
+	int cachedLevelCount() const;
+
+	// Evaluator of the cage's limit surface at any (cage face, u, v)
+	const LimitEvaluator& limitEvaluator();
+
 	Vec<Vec3>& points();
 	const Vec<Vec3>& points() const;
+	const Vec<Vec4i>& quads() const { return sharedLevel ? sharedLevel->faces : faces; }
+	const Vec<Vec3i>& triangles() const { return sharedLevel ? sharedLevel->triFaces : triFaces; }
 
 private:
 	void triangulate(); // turn quad faces into triangular faces. Used after subdivion.
+	void buildAdaptive();
+	void tessellateAdaptive();
+	void updateLimit();
+	void rebuildUniform(); // current uniform level again from the cage
+	bool editLevels(int i, const Vec3 &p); // false if the levels cannot be updated locally
+	bool sharesTopology() const; // true if steps take their connectivity from refinement
+	void levelTopology(int l, const Vec<Vec4i> &levelFaces, int vertCount, Topology &t); // fills t if it is missing
+
+	void prepareJob(SubdivisionJob &step, bool snapshot); // snapshot copies the level, the step borrows it otherwise
+	void finishJob(SubdivisionJob &step, bool lent);
+
+	void touch(); // new version of the current level
+	void restoreCage(); // back to level 0, the cage must be saved
+	void storeLevel(); // move the current level into the cache
+	bool restoreLevel(int l); // move level l out of the cache, false if it is not there
+	void evictLevels();
+	void clearLevelCache();
+	void recycle(CachedLevel &c); // keep the buffers of c in spare if they are the largest so far
 
 	friend Mesh* newDefaultCube();
 };
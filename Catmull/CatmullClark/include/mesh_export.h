@@ -0,0 +1,48 @@
+#ifndef MESH_EXPORT_H
+#define MESH_EXPORT_H
+
+// C std
+#include <cstddef>
+
+#include "common_defines.h"
+#include "mapped_file.h"
+
+enum class ExportFormat {
+	Ply, // binary_little_endian, float x y z and a list of int vertex_indices per face
+	Native, // NativeHeader, then the points and the faces as they are in memory
+};
+
+// Native format, everything little endian as on the targets
+struct NativeHeader {
+	char magic[8]; // "CCMESH01"
+	int level; // Subdivisions applied to the cage, -1 if not known
+	int faceVerts; // 4 for quads, 3 for triangles
+	long long vertCount; // Vec3 after the header
+	long long faceCount; // faceVerts ints each after the points
+};
+
+// Bytes written and the time from opening the file until it is on disk
+struct ExportStats {
+	size_t bytes = 0;
+	double ms = 0.0;
+	double syncMs = 0.0; // Part of ms spent flushing to disk at the end
+
+public:
+	double mbPerSecond() const { return ms > 0.0 ? bytes / double(1 << 20) / (ms * 1e-3) : 0.0; }
+};
+
+// A level written with a few large writes straight from ps and the faces, quads if there are any and
+// triangles otherwise. Only the PLY face lists go through a small buffer, for their count bytes.
+// False with a message on stderr on error, stats may then be null or partial.
+bool exportLevel(const char *path, ExportFormat format, int level, const Vec<Vec3> &ps, const Vec<Vec4i> &quads,
+	const Vec<Vec3i> &tris, ExportStats *stats = nullptr);
+
+// A level in a mapped file, e.g. a StreamedMesh, written a slice at a time. The pages of each slice are
+// released once it is written, so a level larger than the RAM is never resident as a whole.
+bool exportMapped(const char *path, ExportFormat format, int level, MappedFile &file, const Vec3 *ps, long long vertCount,
+	const Vec4i *quads, long long quadCount, ExportStats *stats = nullptr);
+
+// .ply is PLY, anything else the native format
+ExportFormat exportFormatOf(const char *path);
+
+#endif // MESH_EXPORT_H
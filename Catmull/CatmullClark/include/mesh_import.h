@@ -0,0 +1,33 @@
+#ifndef MESH_IMPORT_H
+#define MESH_IMPORT_H
+
+#include "common_defines.h"
+
+// Faces of a cage that are not quads. Polygon p has the vertices verts[offsets[p]] to verts[offsets[p + 1] - 1].
+struct Polygons {
+	Vec<int> offsets; // count() + 1 entries, empty when there are none
+	Vec<int> verts;
+
+public:
+	int count() const { return offsets.empty() ? 0 : int(offsets.size()) - 1; }
+	void clear();
+};
+
+// Cages read from a mapped file cut in chunks parsed in parallel, straight into ps, quads and polygons.
+// Return false with a message on stderr if the file cannot be read, the outputs are undefined then.
+// OBJ: the v and f lines, texture and normal indices of the faces are skipped as is everything else.
+bool importObj(const char *path, Vec<Vec3> &ps, Vec<Vec4i> &quads, Polygons &polygons);
+// PLY: binary, either byte order. The x, y, z of the vertex element and the vertex_indices of the face element.
+bool importPly(const char *path, Vec<Vec3> &ps, Vec<Vec4i> &quads, Polygons &polygons);
+// By the extension of path
+bool importCage(const char *path, Vec<Vec3> &ps, Vec<Vec4i> &quads, Polygons &polygons);
+
+// One Catmull-Clark step of the quads and polygons together, the rules of subdivision_kernels.cpp
+// applied to any face size. Every face becomes quads, the polygons are cleared.
+void subdividePolygons(Vec<Vec3> &ps, Vec<Vec4i> &quads, Polygons &polygons);
+
+// Number at s in the C locale whatever the process one is, s is moved past it. False if there is none.
+bool parseFloat(const char *&s, const char *end, float &value);
+bool parseInt(const char *&s, const char *end, int &value);
+
+#endif // MESH_IMPORT_H
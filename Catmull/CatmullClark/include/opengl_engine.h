@@ -8,6 +8,8 @@
 
 #include "camera.h"
 #include "shader.h"
+#include "subdivision_profile.h"
+#include "view_tessellation.h"
 
 struct UIEngine;
 struct Mesh;
@@ -33,9 +35,71 @@ private:
 	float rotationZ = 0.f;
 
 	Shader program;
-	unsigned int VAO;
-	unsigned int VBO;
-	unsigned int IBO;
+
+	// Vertex or index storage. With GL 4.4 it is immutable and mapped for good, levels are copied from
+	// the mesh into the mapping without a GL call. The mesh keeps its copy for the level cache, cage
+	// edits and export. Older contexts get a plain buffer written with glBufferSubData.
+	struct GpuBuffer {
+		unsigned int id = 0;
+		size_t capacity = 0; // Bytes
+		char *mapped = nullptr; // Null without buffer storage
+		GLsync fence = nullptr; // Set when the buffer was put aside, the GPU may read it until then
+	};
+	bool bufferStorage = false; // GL 4.4 or ARB_buffer_storage
+
+	// Buffers of every level the mesh keeps. NBO is empty when the level has no normals.
+	struct LevelBuffers {
+		unsigned int VAO = 0;
+		GpuBuffer VBO, NBO, IBO;
+		unsigned int version = 0; // Mesh version uploaded, 0 if there are no buffers
+		unsigned int indexCount = 0; // Grids draw per patch instead
+	};
+	Vec<LevelBuffers> levelBuffers;
+	int shownLevel = -1; // Level drawn, the previous one while the current one is still uploading
+
+	// Buffers of dropped levels, handed to the next level they are large enough for
+	Vec<GpuBuffer> spareBuffers;
+	size_t spareBudget = size_t(256) << 20; // Bytes kept aside, the oldest buffers go first
+
+	// Level written into fresh buffers a slice per frame, the shown one is drawn meanwhile.
+	// The mesh changing again restarts it.
+	struct Upload {
+		int level = -1; // -1 if none
+		LevelBuffers buffers;
+		size_t pointBytes = 0, normalBytes = 0, indexBytes = 0;
+		size_t pointsDone = 0, normalsDone = 0, indicesDone = 0;
+	};
+	Upload upload;
+	size_t uploadBudget = size_t(64) << 20; // Bytes written per frame
+	// Uploads are timed into the PhaseUpload of their level in Mesh::profile, a frame per call
+	PhaseTimer uploadTimer;
+	size_t createdBytes = 0; // Of all the buffers created so far, what the profile counts as allocated
+
+	// Levels kept as grids have the points of every patch in turn in the VBO and the triangles of
+	// one patch in the IBO, drawn once per patch from its first point
+	Vec<int> patchCounts;
+	Vec<const void*> patchOffsets;
+	Vec<int> patchBaseVertices;
+
+	// View-dependent tessellation of the limit surface, drawn instead of the mesh while it is on.
+	// The patches of one level sit in equal slots of a pool, a patch is only uploaded when it changed.
+	struct PatchPool {
+		unsigned int VAO = 0, VBO = 0, IBO = 0;
+		int capacity = 0; // Slots of the VBO
+		int slotCount = 0; // Slots handed out so far
+		Vec<int> freeSlots;
+		Vec<int> counts; // Draws of the used slots
+		Vec<const void*> offsets;
+		Vec<int> baseVertices;
+	};
+	bool viewDependent = false;
+	ViewTessellation viewTessellation;
+	Vec<PatchPool> patchPools; // One per level
+	Vec<Vec2i> patchSlots; // (level, slot) of each cage face, level -1 if it has none
+	int patchesUploaded = 0; // In the last frame
+
+	// Level read back from a streamed file, drawn instead of the mesh until the mesh changes
+	LevelBuffers streamedBuffers;
 
 	struct {
 		bool firstMove : 1;
@@ -61,15 +125,40 @@ public:
 	void render();
 	void cleanup();
 
+	// Upload a level written by StreamingSubdivision, slice by slice from its mapping
+	bool showStreamed(const char *path);
+	void hideStreamed();
+
+	// Replace the cage with the one of an OBJ or PLY file, see Mesh::importMesh
+	bool importMesh(const char *path);
+
 private:
 	void init();
 	void shutdown();
 	
 	void initCamera();
-	void prepareData();
+	void beginUpload();
+	bool continueUpload(); // true once the upload is complete
+	void finishUpload();
+	void cancelUpload();
+	void uploadPatchPoints(GpuBuffer &buffer, int first, int count);
+	void selectPatchDraws();
+	void selectLevelBuffers();
+	void releaseStaleLevels();
+	void setupVertexArray(const LevelBuffers &buffers);
+	void releaseLevelBuffers(LevelBuffers &buffers);
+
+	void reserveBuffer(GpuBuffer &buffer, size_t bytes);
+	void writeBuffer(GpuBuffer &buffer, size_t offset, const void *data, size_t bytes);
+	void releaseBuffer(GpuBuffer &buffer);
+	void deleteBuffer(GpuBuffer &buffer);
+	void waitBuffer(GpuBuffer &buffer);
 
 	void clearErrors();
 	void renderData();
+	void renderViewDependent(const glm::mat4 &mvp);
+	int allocatePatch(int level);
+	void deletePatchPools();
 
 	// GLFW callbacks
 	static void frame_buf_size_callback(GLFWwindow *window, int w, int h);
@@ -0,0 +1,61 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <cstdint>
+#include <functional>
+
+#include "common_defines.h"
+
+struct Range {
+	int begin;
+	int end;
+};
+
+// Number of threads the parallel loops split their work in (the calling thread included).
+// Defaults to the number of hardware threads. Loops running while it changes finish on the old pool.
+int threadCount();
+void setThreadCount(int n);
+
+// Number of ranges to split count elements in, so that each gets at least grain of them.
+inline int rangeCount(int count, int grain = 4096) {
+	return Max(1, Min(threadCount(), count / Max(1, grain)));
+}
+
+// i-th of n contiguous ranges of [0, count) with almost equal sizes.
+inline Range splitRange(int count, int n, int i) {
+	const long long c = count;
+	return { int(c * i / n), int(c * (i + 1) / n) };
+}
+
+// Call fn(i) for each i in [0, n) on the worker pool. Returns when all calls are done.
+// Calls made from inside a worker, or while another thread uses the pool, run serially.
+void parallelInvoke(int n, const std::function<void(int)> &fn);
+
+// Call fn(begin, end) for contiguous ranges covering [0, count) in parallel.
+// Every element is visited exactly once, so results written per element do not depend on the split.
+template <class Func>
+void parallelFor(int count, Func fn, int grain = 4096) {
+	const int n = rangeCount(count, grain);
+	parallelInvoke(n, [&](int i) {
+		const Range r = splitRange(count, n, i);
+		fn(r.begin, r.end);
+	});
+}
+
+// Exclusive prefix sum of values in place. Returns the total.
+int parallelScan(Vec<int> &values, int grain = 4096);
+
+// A 64-bit key and the value it sorts, e.g. an edge and its half-edge
+struct SortKey {
+	uint64_t key;
+	int value;
+};
+
+// Number of bits needed to store values in [0, count)
+int bitsFor(int count);
+
+// Stable LSD radix sort on the lowest keyBits bits of the keys. Every pass builds per-range
+// histograms in parallel, turns them into scatter offsets and scatters each range in parallel.
+void radixSort(Vec<SortKey> &keys, int keyBits);
+
+#endif // PARALLEL_H
@@ -0,0 +1,18 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+// SIMD_X64 is defined when the SSE / AVX2 code paths can be compiled.
+// AVX2 functions are marked with TARGET_AVX2 and only called after a CPUID check,
+// so the project does not need to be built with /arch:AVX2.
+#if defined(_M_X64) || defined(__x86_64__)
+#define SIMD_X64 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define TARGET_AVX2
+#else
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+#endif // SIMD_H
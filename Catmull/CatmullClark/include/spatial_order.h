@@ -0,0 +1,29 @@
+#ifndef SPATIAL_ORDER_H
+#define SPATIAL_ORDER_H
+
+#include "common_defines.h"
+#include "topology.h"
+
+// Points of a bounding box quantized to 10 bits per axis and interleaved along the Z-order curve
+struct MortonGrid {
+	Vec3 lo{ 0.f };
+	Vec3 scale{ 0.f };
+
+public:
+	void fit(const Vec<Vec3> &ps);
+	unsigned int code(const Vec3 &p) const;
+};
+
+// Faces sorted along the Z-order curve of their centers, consecutive runs are compact regions
+Vec<int> mortonOrder(const Vec<Vec3> &ps, const Vec<Vec4i> &faces);
+
+// New position vertOrder[v] of every vertex along the Z-order curve, so that vertices close in
+// space are close in memory. Faces need no sorting: refinement puts the children of face f at
+// 4f + j, which already walks every cage face along a quadtree curve.
+void spatialOrder(const Vec<Vec3> &ps, Vec<int> &vertOrder);
+
+// Move the vertices of a level to their new positions and renumber the faces and the topology
+// to match. Faces and edges keep their indices. Parallel.
+void reorderVertices(const Vec<int> &vertOrder, Vec<Vec3> &ps, Vec<Vec4i> &faces, Topology &topology);
+
+#endif // SPATIAL_ORDER_H
@@ -0,0 +1,38 @@
+#ifndef STENCIL_TABLE_H
+#define STENCIL_TABLE_H
+
+#include "common_defines.h"
+#include "topology.h"
+
+// Parent vertex and its weight in a child vertex
+struct Weight {
+	int vert;
+	float weight;
+};
+
+// Child vertex c of one refinement step as weights on the parent vertices, numbered as in
+// Mesh::subdivide. Same rules as the point kernels in subdivision_kernels.cpp.
+void childWeights(const Vec<Vec4i> &faces, const Topology &topology, int c, Vec<Weight> &out);
+
+// N levels of Catmull-Clark refinement factored into weights on the cage vertices.
+// Refined vertex i is the sum of weights[j] * cage[indices[j]] for j in [offsets[i], offsets[i + 1]).
+// Built once for a fixed cage topology, after that moving cage vertices only needs evaluate().
+struct StencilTable {
+	int cageVertCount = 0;
+	int levels = -1; // -1 until built
+	Vec<int> offsets;
+	Vec<int> indices;
+	Vec<float> weights;
+
+public:
+	// Refined vertices are numbered as Mesh::subdivide numbers them after the same number of levels.
+	void build(const Vec<Vec4i> &cageFaces, int cageVertCount, int levels);
+	bool matches(int cageVerts, int lvls) const { return levels == lvls && cageVertCount == cageVerts; }
+
+	int refinedVertCount() const { return int(offsets.size()) - 1; }
+
+	// Sparse matrix-vector product out = S * cage. Parallel, SSE when available.
+	void evaluate(const Vec<Vec3> &cage, Vec<Vec3> &out) const;
+};
+
+#endif // STENCIL_TABLE_H
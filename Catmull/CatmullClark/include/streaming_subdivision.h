@@ -0,0 +1,73 @@
+#ifndef STREAMING_SUBDIVISION_H
+#define STREAMING_SUBDIVISION_H
+
+// C++ std
+#include <atomic>
+#include <thread>
+
+#include "common_defines.h"
+#include "mapped_file.h"
+#include "mesh_export.h"
+
+// Level written by StreamingSubdivision. The file holds the header, faceOrder (cageFaceCount ints),
+// vertCount points and quadCount quads. Vertices are numbered from the cage alone: the cage vertices,
+// then the 2^level - 1 inner points of every cage edge, then the (2^level - 1)^2 inner points of each
+// cage face. Quads come in 4^level blocks, block s is the grid of cage face faceOrder[s], row major.
+struct StreamedHeader {
+	char magic[8];
+	int level;
+	int cageFaceCount;
+	long long vertCount;
+	long long quadCount;
+};
+
+// Read side of a streamed level, pages are only loaded when touched
+struct StreamedMesh {
+	MappedFile file;
+	StreamedHeader header{};
+
+public:
+	bool open(const char *path);
+	void close() { file.close(); }
+
+	long long vertCount() const { return header.vertCount; }
+	long long quadCount() const { return header.quadCount; }
+	const int* faceOrder() const;
+	const Vec3* points() const;
+	const Vec4i* quads() const;
+};
+
+// Uniform subdivision of a cage to levels that do not fit in memory. The cage is cut in chunks of
+// nearby faces, each chunk is refined together with its one-ring and written straight to a mapped
+// file. Only the chunk is in memory at any time, workingSet bounds its size.
+struct StreamingSubdivision {
+	// Inputs
+	int level = 8;
+	size_t workingSet = size_t(256) << 20;
+	Vec<Vec3> cagePs;
+	Vec<Vec4i> cageFaces;
+	String path;
+	// Optional copy of the level in PLY or the native format, see exportFormatOf. It is written from
+	// the mapped file once the level is complete, a slice at a time, on the same thread.
+	String exportPath;
+
+	ExportStats exportStats; // Of the copy, once done
+	std::atomic<int> chunksDone{ 0 };
+	std::atomic<int> chunkCount{ 0 };
+	std::atomic<bool> cancelled{ false };
+	std::atomic<bool> finished{ false };
+	bool succeeded = false;
+	std::thread worker;
+
+public:
+	~StreamingSubdivision();
+
+	bool run(); // On the calling thread, false on error or cancellation
+	void start(); // On a thread of its own
+	void cancel() { cancelled = true; }
+	void wait();
+	bool done() const { return finished; }
+	float progress() const;
+};
+
+#endif // STREAMING_SUBDIVISION_H
@@ -0,0 +1,99 @@
+#ifndef SUBDIVISION_JOB_H
+#define SUBDIVISION_JOB_H
+
+// C++ std
+#include <atomic>
+#include <memory>
+#include <thread>
+
+#include "adaptive_subdivision.h"
+#include "common_defines.h"
+#include "grid_mesh.h"
+#include "subdivision_kernels.h"
+#include "subdivision_profile.h"
+#include "topology.h"
+#include "topology_cache.h"
+
+// How uniform levels are computed. Global sweeps the whole mesh once per level, Tiled refines every
+// cage face depth-first to the target level in a small tile, see tiled_subdivision.h.
+enum class SubdivisionEngine {
+	Global,
+	Tiled,
+};
+
+// Temporaries of the point kernels, handed from one step to the next by Mesh
+struct SubdivisionScratch {
+	PointsSoA oldPs;
+	PointsSoA outPs;
+};
+
+// One subdivision step computed from a copy of a level, so that it can run on its own thread
+// while the level it came from keeps rendering. Mesh fills the inputs, runs the job and moves
+// the outputs in once it is done. Cancellation is checked between stages.
+struct SubdivisionJob {
+	// Inputs
+	bool adaptive = false;
+	SubdivisionEngine engine = SubdivisionEngine::Global;
+	bool limitProjection = false;
+	bool spatialOrder = false; // Global engine only
+	bool gridStorage = false; // Tiled engine only, the level comes as points and a GridMesh without limit
+	int patchRate = 1;
+	int level = 0; // Level of the result
+	Vec<Vec3> ps;
+	Vec<Vec4i> faces;
+	Topology topology;
+	// Global engine without reordering: connectivity of the cage's levels shared with other meshes.
+	// faces and topology are not needed then, only the points are computed.
+	std::shared_ptr<RefinementTopology> refinement;
+	Vec<Vec3> cagePs; // Adaptive mode and the tiled engine start from the cage
+	Vec<Vec4i> cageFaces;
+
+	// Outputs, the fields of a Mesh level
+	Vec<Vec3> newPs;
+	Vec<Vec4i> newFaces;
+	Vec<Vec3i> triFaces;
+	Topology newTopology;
+	Vec<Vec3> limitPs;
+	Vec<Vec3> normals;
+	Vec<int> vertOrder; // With spatialOrder, position of each vertex of newPs in refinement order
+	GridMesh grid; // With gridStorage, newFaces and triFaces stay empty then
+	// With a refinement, the connectivity of the result. newFaces, triFaces and newTopology stay empty then.
+	std::shared_ptr<const TopologyLevel> sharedLevel;
+	AdaptiveMesh adaptiveMesh;
+
+	// Memory of earlier steps. The outputs above may come with capacity from a dropped level too.
+	SubdivisionScratch scratch;
+
+	// Every stage timed as its phase, with the elements it went through. Empty without SUBDIVISION_PROFILE.
+	LevelProfile profile;
+	PhaseTimer phaseTimer;
+
+	std::atomic<int> stage{ 0 };
+	std::atomic<bool> cancelled{ false };
+	std::atomic<bool> finished{ false };
+	std::thread worker;
+
+public:
+	~SubdivisionJob();
+
+	void run(); // On the calling thread
+	void start(); // On a thread of its own
+	void cancel() { cancelled = true; }
+	void wait();
+	bool done() const { return finished; }
+	bool fromCage() const { return adaptive || engine == SubdivisionEngine::Tiled; }
+
+	int stageCount() const;
+	const char* stageName() const;
+	float progress() const; // Stages done over stage count
+
+private:
+	bool enter(int s);
+	Phase phaseOf(int s) const;
+	size_t heldBytes() const; // Outputs and scratch, allocations are counted by its growth
+	void runUniform();
+	void runTiled();
+	void runAdaptive();
+};
+
+#endif // SUBDIVISION_JOB_H
@@ -0,0 +1,52 @@
+#ifndef SUBDIVISION_KERNELS_H
+#define SUBDIVISION_KERNELS_H
+
+#include "common_defines.h"
+#include "topology.h"
+
+// Positions as structure of arrays, the layout the vectorized kernels work on.
+struct PointsSoA {
+	Vec<float> x, y, z;
+
+public:
+	int size() const { return int(x.size()); }
+	void resize(int n);
+
+	Vec3 get(int i) const { return { x[i], y[i], z[i] }; }
+	void set(int i, const Vec3 &p) { x[i] = p.x; y[i] = p.y; z[i] = p.z; }
+
+	void fromAoS(const Vec<Vec3> &ps);
+	void toAoS(Vec<Vec3> &ps) const;
+};
+
+enum class SimdPath {
+	Scalar,
+	SSE,
+	AVX2,
+};
+
+// Instruction set the kernels use. Defaults to the best one the CPU supports.
+SimdPath simdPath();
+// Force a path, e.g. for benchmarks. Clamped to what the CPU supports.
+void setSimdPath(SimdPath path);
+const char* simdPathName(SimdPath path);
+
+// Catmull-Clark point rules over [begin, end) of the faces, edges or old vertices.
+// Output is ordered [vertex points (n) | face points (m) | edge points (k)] as in Mesh::subdivide.
+// Edge and vertex points read the face points from out, so faces go first.
+// All paths do the same float operations in the same order, so their results are bitwise equal.
+void facePointsKernel(const Vec<Vec4i> &faces, const PointsSoA &ps, PointsSoA &out, int begin, int end);
+void edgePointsKernel(const Topology &topology, const PointsSoA &ps, PointsSoA &out, int begin, int end);
+void vertexPointsKernel(const Topology &topology, const PointsSoA &ps, PointsSoA &out, int begin, int end);
+
+// Vertex rule of class c for the vertices [begin, end). Same results as vertexPointsKernel,
+// without the per-vertex branches on valence and border.
+void vertexClassKernel(VertexClass c, const Topology &topology, const PointsSoA &ps, PointsSoA &out, int begin, int end);
+
+// The kernels over all faces, edges or old vertices, split over the worker threads.
+// updatePoints runs the class kernels over the vertex runs of the topology if it has them.
+void findFacePoints(const Vec<Vec4i> &faces, const PointsSoA &ps, PointsSoA &newPs);
+void findEdgePoints(const Topology &topology, const PointsSoA &ps, PointsSoA &newPs);
+void updatePoints(const Topology &topology, const PointsSoA &ps, PointsSoA &newPs);
+
+#endif // SUBDIVISION_KERNELS_H
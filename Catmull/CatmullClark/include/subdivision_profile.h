@@ -0,0 +1,76 @@
+#ifndef SUBDIVISION_PROFILE_H
+#define SUBDIVISION_PROFILE_H
+
+// C std
+#include <cstdio>
+
+// C++ std
+#include <chrono>
+
+#include "common_defines.h"
+
+// Timers and counters of the subdivision steps and of the level uploads. Built with SUBDIVISION_PROFILE
+// defined as 0 they are compiled out: PROFILE(...) expands to nothing and the profiles stay empty.
+#ifndef SUBDIVISION_PROFILE
+#define SUBDIVISION_PROFILE 1
+#endif
+
+#if SUBDIVISION_PROFILE
+#define PROFILE(...) __VA_ARGS__
+#else
+#define PROFILE(...)
+#endif
+
+// The stages of the subdivision jobs of all engines, then the upload of the level by the renderer
+enum Phase {
+	PhaseTopology, PhaseFacePoints, PhaseEdgePoints, PhaseVertexPoints, PhaseRefinement, PhaseReordering,
+	PhaseLimit, PhaseTriangulation, PhaseTiles, PhaseAdaptive, PhaseTessellation, PhaseUpload,
+	PHASE_COUNT
+};
+const char* phaseName(Phase phase);
+
+struct PhaseStats {
+	int calls = 0; // Times the phase ran, frames for an upload spread over several
+	double ms = 0.0;
+	long long elements = 0; // Faces, edges or vertices gone through or made, see SubdivisionJob
+	size_t allocatedBytes = 0; // Growth of the memory held by the outputs, GPU buffers created for the upload
+	size_t uploadedBytes = 0;
+};
+
+// One level, as it was computed and uploaded last
+struct LevelProfile {
+	int level = -1; // -1 if nothing was recorded
+	PhaseStats phases[PHASE_COUNT];
+
+public:
+	double ms() const;
+	void count(Phase phase, long long elements) { phases[phase].elements += elements; }
+};
+
+// Times one phase after the other, the open one ends when the next one starts or on close
+struct PhaseTimer {
+	int phase = -1;
+	size_t heldBytes = 0; // When the phase started
+	std::chrono::high_resolution_clock::time_point start;
+
+public:
+	void open(LevelProfile &profile, Phase next, size_t held);
+	void close(LevelProfile &profile, size_t held);
+};
+
+// The levels of a mesh, levels[l] for level l
+struct SubdivisionProfile {
+	Vec<LevelProfile> levels;
+
+public:
+	LevelProfile& at(int level); // Added if missing
+	void record(const LevelProfile &profile); // Replaces the level of profile, its upload included
+	void clear() { levels.clear(); }
+
+	// {"levels": [{"level", "ms", "phases": [{"phase", "calls", "ms", "elements", ...}]}]}, only the
+	// recorded levels and the phases that ran. False with a message on stderr if it cannot be written.
+	bool writeJson(const char *path) const;
+	void writeJson(FILE *out, const char *indent) const; // The levels array alone, each line after indent
+};
+
+#endif // SUBDIVISION_PROFILE_H
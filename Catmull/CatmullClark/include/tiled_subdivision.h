@@ -0,0 +1,48 @@
+#ifndef TILED_SUBDIVISION_H
+#define TILED_SUBDIVISION_H
+
+#include "adaptive_subdivision.h"
+#include "common_defines.h"
+#include "topology.h"
+
+// Numbering of the vertices of a uniform level that only depends on the cage, so that tiles refined
+// apart agree on the vertices they share: the cage vertices, then the 2^level - 1 inner points of
+// every cage edge, then the (2^level - 1)^2 inner points of every cage face, faces in slot order.
+// Cage face f owns the 4^level quads starting at slots[f] * 4^level, row major over its grid.
+struct CageGrid {
+	const Vec<Vec4i> *faces = nullptr;
+	const Topology *cage = nullptr;
+	const Vec<int> *slots = nullptr; // Position of each cage face in the output
+	long long n = 0; // 2^level
+	long long edgeBase = 0;
+	long long faceBase = 0;
+
+public:
+	void init(const Vec<Vec4i> &cageFaces, const Topology &cageTopology, const Vec<int> &faceSlots, int level);
+	long long vertCount() const { return faceBase + (long long)faces->size() * (n - 1) * (n - 1); }
+	long long quadCount() const { return (long long)faces->size() * n * n; }
+
+	// Index of grid vertex (x, y) of cage face f. A vertex shared by several cage faces is written
+	// by one of them only, owner tells if f is that one.
+	long long vertex(int f, int x, int y, bool &owner) const;
+};
+
+// Number of cage faces per tile so that refining a tile to level takes about bytes
+int tileFaceCount(int faceCount, int level, size_t bytes);
+
+// Refine the cage faces tileFaces[0, count) to level together with their one-ring.
+// The owned faces of the result are their 4^level descendants.
+void refineTile(const Vec<Vec3> &cagePs, const Vec<Vec4i> &cageFaces, const Topology &cage,
+	const int *tileFaces, int count, int level, AdaptiveLevel &tile);
+
+// Write the owned quads of a refined tile and the grid vertices they own. quads may be null.
+void writeTile(const AdaptiveLevel &tile, const CageGrid &grid, Vec3 *points, Vec4i *quads);
+
+// Uniform subdivision of a cage straight to level, one small tile of nearby cage faces at a time.
+// Each tile is refined depth-first while it stays in cache and tiles run in parallel. The result is
+// numbered as in CageGrid with slot f for cage face f and has no cracks between tiles.
+void tiledSubdivide(const Vec<Vec3> &cagePs, const Vec<Vec4i> &cageFaces, int level, Vec<Vec3> &ps, Vec<Vec4i> &faces);
+// The points of tiledSubdivide alone, for levels kept as a GridMesh
+void tiledPoints(const Vec<Vec3> &cagePs, const Vec<Vec4i> &cageFaces, int level, Vec<Vec3> &ps);
+
+#endif // TILED_SUBDIVISION_H
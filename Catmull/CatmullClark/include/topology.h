@@ -0,0 +1,91 @@
+#ifndef TOPOLOGY_H
+#define TOPOLOGY_H
+
+#include "common_defines.h"
+
+// Vertices whose vertex rule has a kernel of its own, with the valence known at compile time
+enum VertexClass {
+	Interior3, Interior4, Interior5, Interior6, // as many faces as edges
+	Corner, // 2 border edges and 1 face
+	Border3, // 3 edges of which 2 on the border, 2 faces
+	GenericVertex, // anything else: other valences, isolated vertices, unusual borders
+};
+
+// Consecutive vertices [begin, end) of one class
+struct VertexRun {
+	int begin, end;
+	VertexClass vertexClass;
+};
+
+// Connectivity of a quad mesh, kept as flat arrays so it can be refined level by level
+// without rediscovering adjacency. The face-vertex relation is the mesh's face array itself.
+//
+// Vertex relations are stored in compressed-sparse-row form: the edges of vertex v are
+// vertEdges[vertEdgeOffsets[v] .. vertEdgeOffsets[v + 1]), same for the faces.
+struct Topology {
+	int vertCount = 0;
+
+	Vec<Vec4i> faceEdges; // for each face -> 4 edge indices. Edge j connects face verts j and j + 1
+	Vec<Vec2i> edgeVerts; // for each edge -> 2 vertex indices
+	Vec<Vec2i> edgeFaces; // for each edge -> 2 adjacent faces. The second one is -1 on a border of a hole
+
+	Vec<int> vertEdgeOffsets; // vertCount + 1 entries
+	Vec<int> vertEdges;
+	Vec<int> vertFaceOffsets; // vertCount + 1 entries
+	Vec<int> vertFaces;
+
+	// All vertices in vertex order, the runs as long as the classes allow. A refined topology takes them
+	// from its parent, a built one classifies its vertices. Empty after reordering, see reorderVertices.
+	Vec<VertexRun> vertexRuns;
+
+public:
+	int faceCount() const { return int(faceEdges.size()); }
+	int edgeCount() const { return int(edgeVerts.size()); }
+
+	int edgeValence(int v) const { return vertEdgeOffsets[v + 1] - vertEdgeOffsets[v]; }
+	int faceValence(int v) const { return vertFaceOffsets[v + 1] - vertFaceOffsets[v]; }
+
+	bool isBoundaryEdge(int e) const { return edgeFaces[e].y == -1; }
+	// Face across edge e from face f, -1 on a border
+	int otherFace(int e, int f) const { return edgeFaces[e].x == f ? edgeFaces[e].y : edgeFaces[e].x; }
+	// A vertex with less faces than edges lies on a border of a hole
+	bool isBoundaryVert(int v) const { return edgeValence(v) != faceValence(v); }
+	// Interior vertex with 4 edges and 4 faces
+	bool isRegularVert(int v) const { return edgeValence(v) == 4 && faceValence(v) == 4; }
+
+	// True if the topology was built for these faces
+	bool matches(const Vec<Vec4i> &faces) const { return faceEdges.size() == faces.size(); }
+
+	size_t bytes() const; // Memory held by the arrays
+};
+
+// Position of v (or e) inside a face. Expects it to be there.
+template <int N>
+int localIndex(const VecNi<N> &v, int idx) {
+	for (int i = 0; i < N; ++i) {
+		if (v[i] == idx) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+// Discover edges and adjacency of an arbitrary quad mesh. Used for the base level only.
+void buildTopology(const Vec<Vec4i> &faces, int vertCount, Topology &topology);
+
+VertexClass vertexClassOf(const Topology &topology, int v);
+// The vertex runs from the class of every vertex
+void classifyVertices(Topology &topology);
+
+// Derive the topology of the next subdivision level directly from the parent one.
+// Child vertices are ordered [parent verts, face points, edge points], child face 4 * f + j
+// is the one at corner j of parent face f. Parent verts keep their class, face points are
+// Interior4 and edge points Interior4, or Border3 on a border.
+void refineTopology(const Vec<Vec4i> &faces, const Topology &parent, Vec<Vec4i> &childFaces, Topology &child);
+
+// Two triangles per quad, split along the diagonal from vertex 0
+void triangulate(const Vec<Vec4i> &faces, Vec<Vec3i> &triFaces);
+// The same into memory for 2 * count triangles, e.g. a mapped GL buffer
+void triangulate(const Vec4i *faces, int count, Vec3i *triFaces);
+
+#endif // TOPOLOGY_H
@@ -0,0 +1,47 @@
+#ifndef TOPOLOGY_CACHE_H
+#define TOPOLOGY_CACHE_H
+
+// C std
+#include <cstdint>
+
+// C++ std
+#include <memory>
+#include <mutex>
+
+#include "common_defines.h"
+#include "topology.h"
+
+// Connectivity of one uniform level: what a subdivision step computes apart from the positions
+struct TopologyLevel {
+	Vec<Vec4i> faces;
+	Topology topology;
+	Vec<Vec3i> triFaces;
+};
+
+// The uniform levels of a cage's connectivity, refined once and shared by every mesh with the same
+// cage faces, e.g. morphs and variants of one character. Levels are refined on first use.
+// The vertices of level l + 1 are those of level l refined in the order of subdivision_kernels.h.
+struct RefinementTopology {
+	uint64_t key = 0; // connectivityHash of level 0
+	int vertCount = 0;
+
+public:
+	// Level l, refined first if needed. Thread safe, the level stays valid as long as this does.
+	const TopologyLevel& level(int l);
+	int levelCount() const; // Levels refined so far
+	size_t bytes() const;
+
+private:
+	mutable std::mutex mutex;
+	Vec<std::unique_ptr<TopologyLevel>> levels;
+
+	friend std::shared_ptr<RefinementTopology> sharedTopology(const Vec<Vec4i> &cageFaces, int vertCount);
+};
+
+uint64_t connectivityHash(const Vec<Vec4i> &faces, int vertCount);
+
+// The refinement topology of these cage faces. Meshes holding one for the same connectivity get
+// that one, a new one is made otherwise. It goes away with the last mesh holding it.
+std::shared_ptr<RefinementTopology> sharedTopology(const Vec<Vec4i> &cageFaces, int vertCount);
+
+#endif // TOPOLOGY_CACHE_H
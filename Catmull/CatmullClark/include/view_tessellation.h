@@ -0,0 +1,49 @@
+#ifndef VIEW_TESSELLATION_H
+#define VIEW_TESSELLATION_H
+
+#include "common_defines.h"
+#include "limit_evaluator.h"
+#include "topology.h"
+
+struct PatchVertex {
+	Vec3 p;
+	Vec3 normal;
+};
+
+// Tessellation of the limit surface picked per frame from the view. Every cage face is a patch of
+// 2^level x 2^level quads, the level following the size of the face on screen. A cage edge is
+// sampled at the lower level of its two faces and the finer face collapses its border points onto
+// those samples, so patches of different levels share the exact same border and leave no crack.
+// The quads of a patch are then always the full grid, see gridIndices.
+struct ViewTessellation {
+	// Settings
+	int maxLevel = 6;
+	float quadPixels = 8.f; // Size on screen a quad edge is refined down to
+	long long maxTriangles = 1ll << 21; // Levels are capped until the whole surface fits
+
+	Vec<int> levels; // Of each cage face
+	Vec<Vec<PatchVertex>> patches; // (2^level + 1)^2 points of each cage face, row major over (u, v)
+	Vec<int> changed; // Faces whose patch changed in the last update
+
+	Vec<Vec3> cagePs; // Cage the patches were made for
+	Vec<Vec4i> cageFaces;
+	Topology cage;
+	Vec<PatchVertex> corners; // Limit point of each cage vertex
+	Vec<int> edgeLevels;
+	Vec<Vec<PatchVertex>> edgeSamples; // 2^edgeLevel + 1 points from edgeVerts.x to edgeVerts.y
+
+public:
+	// Levels for the camera mvp and a width x height viewport, patches evaluated again where they changed.
+	// A new cage starts over. Returns true if any patch changed.
+	bool update(const Vec<Vec3> &ps, const Vec<Vec4i> &faces, const LimitEvaluator &evaluator,
+		const glm::mat4 &mvp, int width, int height);
+	long long triangleCount() const;
+	void clear(); // Drops the patches, the settings stay
+
+private:
+	void reset(const Vec<Vec3> &ps, const Vec<Vec4i> &faces, const LimitEvaluator &evaluator);
+	void pickLevels(const glm::mat4 &mvp, int width, int height, Vec<int> &faceLevels) const;
+	PatchVertex border(int f, int j, int k, int n) const; // Point k of n along side j of face f
+};
+
+#endif // VIEW_TESSELLATION_H
@@ -3,10 +3,17 @@
 out vec4 Color;
 
 uniform vec3 color;
+uniform bool shaded; // true when the mesh has normals
 
 in vec3 pos;
+in vec3 normal;
 
 void main()
 {
-	Color = vec4(pos, 1.f); 
-}
\ No newline at end of file
+	if (shaded) {
+		float light = abs(dot(normalize(normal), normalize(vec3(0.3f, 0.5f, 1.f))));
+		Color = vec4(color * (0.15f + 0.85f * light), 1.f);
+	} else {
+		Color = vec4(pos, 1.f);
+	}
+}
@@ -1,11 +1,15 @@
 #version 450 core
 layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
 
 uniform mat4 MVP;
+uniform mat4 model;
 
 out vec3 pos;
+out vec3 normal;
 
 void main() {
 	gl_Position = MVP * vec4(aPos, 1.0f);
 	pos = aPos;
-}
\ No newline at end of file
+	normal = mat3(model) * aNormal;
+}
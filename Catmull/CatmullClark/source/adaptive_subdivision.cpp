@@ -0,0 +1,356 @@
+#include "adaptive_subdivision.h"
+
+// C++ std
+#include <algorithm>
+
+#include "limit_surface.h"
+#include "mesh.h"
+#include "parallel.h"
+#include "subdivision_kernels.h"
+#include "topology.h"
+
+/*
+============================================================================================
+ Patches
+============================================================================================
+*/
+// Curve of the patch at a fixed v, as 4 control points along u
+inline void collapseRows(const BSplinePatch &patch, const Vec4 &bv, Vec3 q[4]) {
+	for (int c = 0; c < 4; ++c) {
+		q[c] = bv[0] * patch.cps[c] + bv[1] * patch.cps[4 + c] + bv[2] * patch.cps[8 + c] + bv[3] * patch.cps[12 + c];
+	}
+}
+
+Vec3 BSplinePatch::evaluate(float u, float v) const {
+	Vec3 q[4];
+	collapseRows(*this, bsplineBasis(v), q);
+	const Vec4 bu = bsplineBasis(u);
+	return bu[0] * q[0] + bu[1] * q[1] + bu[2] * q[2] + bu[3] * q[3];
+}
+
+Vec3 BSplinePatch::evaluate(float u, float v, Vec3 &du, Vec3 &dv) const {
+	Vec3 q[4], dq[4];
+	collapseRows(*this, bsplineBasis(v), q);
+	collapseRows(*this, bsplineDerivBasis(v), dq);
+	const Vec4 bu = bsplineBasis(u);
+	const Vec4 dbu = bsplineDerivBasis(u);
+	du = dbu[0] * q[0] + dbu[1] * q[1] + dbu[2] * q[2] + dbu[3] * q[3];
+	dv = bu[0] * dq[0] + bu[1] * dq[1] + bu[2] * dq[2] + bu[3] * dq[3];
+	return bu[0] * q[0] + bu[1] * q[1] + bu[2] * q[2] + bu[3] * q[3];
+}
+
+/*
+============================================================================================
+ Refinement
+============================================================================================
+*/
+bool isRegularFace(const Topology &topology, const Vec4i &face) {
+	for (int j = 0; j < Mesh::QUAD_FACE_VERTS; ++j) {
+		if (!topology.isRegularVert(face[j])) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// Neighbor of vertex a in face that is not b
+int otherNeighbor(const Vec4i &face, int a, int b) {
+	const int i = localIndex(face, a);
+	const int next = face[(i + 1) & 3];
+	return next == b ? face[(i + 3) & 3] : next;
+}
+
+// 4x4 control points of a regular face, read off its one-ring
+void extractPatch(const AdaptiveLevel &lvl, int f, BSplinePatch &patch) {
+	static const Vec2i corner[4] = { { 1, 1 }, { 2, 1 }, { 2, 2 }, { 1, 2 } }; // (col, row) of face vertex j
+	static const Vec2i out[4] = { { 0, -1 }, { 1, 0 }, { 0, 1 }, { -1, 0 } }; // step across edge j
+
+	const Topology &topology = lvl.topology;
+	const Vec4i &face = lvl.faces[f];
+	auto put = [&](Vec2i cr, int v) {
+		patch.cps[4 * cr.y + cr.x] = lvl.ps[v];
+	};
+
+	for (int j = 0; j < 4; ++j) {
+		const int a = face[j];
+		const int b = face[(j + 1) & 3];
+		const int g = topology.otherFace(topology.faceEdges[f][j], f);
+		const int gPrev = topology.otherFace(topology.faceEdges[f][(j + 3) & 3], f);
+
+		put(corner[j], a);
+		put(corner[j] + out[j], otherNeighbor(lvl.faces[g], a, b));
+		put(corner[(j + 1) & 3] + out[j], otherNeighbor(lvl.faces[g], b, a));
+
+		// The diagonal face is the fourth one around a
+		for (int i = topology.vertFaceOffsets[a]; i < topology.vertFaceOffsets[a + 1]; ++i) {
+			const int h = topology.vertFaces[i];
+			if (h != f && h != g && h != gPrev) {
+				put(corner[j] + out[j] + out[(j + 3) & 3], lvl.faces[h][(localIndex(lvl.faces[h], a) + 2) & 3]);
+				break;
+			}
+		}
+	}
+}
+
+void refineAround(const AdaptiveLevel &lvl, const Vec<char> &kind, AdaptiveLevel &next) {
+	const Topology &topology = lvl.topology;
+	const int vertCount = topology.vertCount;
+	const int faceCount = int(lvl.faces.size());
+
+	// Vertices of refined faces
+	Vec<char> hot(vertCount);
+	parallelFor(vertCount, [&](int begin, int end) {
+		for (int v = begin; v < end; ++v) {
+			hot[v] = 0;
+			for (int i = topology.vertFaceOffsets[v]; i < topology.vertFaceOffsets[v + 1]; ++i) {
+				hot[v] |= kind[topology.vertFaces[i]] == FACE_REFINE;
+			}
+		}
+	});
+
+	// Faces touching one of them, i.e. the refined faces with their one-ring
+	Vec<char> keep(faceCount);
+	Vec<int> faceMap(faceCount);
+	parallelFor(faceCount, [&](int begin, int end) {
+		for (int f = begin; f < end; ++f) {
+			const Vec4i &face = lvl.faces[f];
+			keep[f] = hot[face[0]] | hot[face[1]] | hot[face[2]] | hot[face[3]];
+			faceMap[f] = keep[f];
+		}
+	});
+	const int subFaceCount = parallelScan(faceMap);
+
+	// Vertices of the kept faces
+	Vec<char> used(vertCount);
+	Vec<int> vertMap(vertCount);
+	parallelFor(vertCount, [&](int begin, int end) {
+		for (int v = begin; v < end; ++v) {
+			used[v] = 0;
+			for (int i = topology.vertFaceOffsets[v]; i < topology.vertFaceOffsets[v + 1]; ++i) {
+				used[v] |= keep[topology.vertFaces[i]];
+			}
+			vertMap[v] = used[v];
+		}
+	});
+	const int subVertCount = parallelScan(vertMap);
+
+	PointsSoA subPs;
+	subPs.resize(subVertCount);
+	parallelFor(vertCount, [&](int begin, int end) {
+		for (int v = begin; v < end; ++v) {
+			if (used[v]) {
+				subPs.set(vertMap[v], lvl.ps[v]);
+			}
+		}
+	});
+
+	Vec<Vec4i> subFaces(subFaceCount);
+	Vec<char> subOwned(subFaceCount);
+	Vec<FaceOrigin> subOrigins(subFaceCount);
+	parallelFor(faceCount, [&](int begin, int end) {
+		for (int f = begin; f < end; ++f) {
+			if (keep[f]) {
+				const Vec4i &face = lvl.faces[f];
+				subFaces[faceMap[f]] = { vertMap[face[0]], vertMap[face[1]], vertMap[face[2]], vertMap[face[3]] };
+				subOwned[faceMap[f]] = kind[f] == FACE_REFINE;
+				subOrigins[faceMap[f]] = lvl.origins[f];
+			}
+		}
+	});
+
+	// One uniform step on the submesh
+	Topology subTopology;
+	buildTopology(subFaces, subVertCount, subTopology);
+
+	PointsSoA newPs;
+	newPs.resize(subTopology.vertCount + subTopology.faceCount() + subTopology.edgeCount());
+	findFacePoints(subFaces, subPs, newPs);
+	findEdgePoints(subTopology, subPs, newPs);
+	updatePoints(subTopology, subPs, newPs);
+	newPs.toAoS(next.ps);
+
+	refineTopology(subFaces, subTopology, next.faces, next.topology);
+
+	next.owned.resize(next.faces.size());
+	next.origins.resize(next.faces.size());
+	parallelFor(subFaceCount, [&](int begin, int end) {
+		for (int f = begin; f < end; ++f) {
+			for (int j = 0; j < Mesh::QUAD_FACE_VERTS; ++j) {
+				next.owned[4 * f + j] = subOwned[f];
+				next.origins[4 * f + j] = subOrigins[f].child(j);
+			}
+		}
+	});
+}
+
+void AdaptiveMesh::build(const Vec<Vec3> &cagePs, const Vec<Vec4i> &cageFaces, int lvls) {
+	levels = lvls;
+	patches.clear();
+	ps.clear();
+	normals.clear();
+	faces.clear();
+	faceOrigins.clear();
+
+	AdaptiveLevel lvl;
+	lvl.ps = cagePs;
+	lvl.faces = cageFaces;
+	buildTopology(lvl.faces, lvl.ps.size(), lvl.topology);
+	lvl.owned.assign(lvl.faces.size(), 1);
+	lvl.origins.resize(lvl.faces.size());
+	for (int f = 0; f < int(lvl.faces.size()); ++f) {
+		lvl.origins[f] = { f, 0, { 0, 0 } };
+	}
+
+	for (int level = 0; ; ++level) {
+		const bool last = level == levels;
+		const int faceCount = int(lvl.faces.size());
+		const int n = rangeCount(faceCount);
+
+		Vec<char> kind(faceCount);
+		Vec<int> patchOffsets(faceCount);
+		Vec<int> refineCounts(n, 0);
+		parallelInvoke(n, [&](int t) {
+			const Range r = splitRange(faceCount, n, t);
+			for (int f = r.begin; f < r.end; ++f) {
+				if (!lvl.owned[f]) {
+					kind[f] = FACE_SKIP;
+				} else if (isRegularFace(lvl.topology, lvl.faces[f])) {
+					kind[f] = FACE_PATCH;
+				} else {
+					kind[f] = last ? FACE_FINAL : FACE_REFINE;
+				}
+				patchOffsets[f] = kind[f] == FACE_PATCH;
+				refineCounts[t] += kind[f] == FACE_REFINE;
+			}
+		});
+
+		const int first = int(patches.size());
+		patches.resize(first + parallelScan(patchOffsets));
+		parallelFor(faceCount, [&](int begin, int end) {
+			for (int f = begin; f < end; ++f) {
+				if (kind[f] == FACE_PATCH) {
+					BSplinePatch &patch = patches[first + patchOffsets[f]];
+					extractPatch(lvl, f, patch);
+					patch.origin = lvl.origins[f];
+				}
+			}
+		});
+
+		if (last) {
+			break;
+		}
+
+		bool refine = false;
+		for (int count : refineCounts) {
+			refine |= count > 0;
+		}
+		if (!refine) {
+			return;
+		}
+
+		AdaptiveLevel next;
+		refineAround(lvl, kind, next);
+		lvl = std::move(next);
+	}
+
+	// Faces still irregular at the last level, with their vertices on the limit
+	const int vertCount = lvl.topology.vertCount;
+	const Vec<char> &owned = lvl.owned;
+	Vec<char> used(vertCount, 0);
+	for (int f = 0; f < int(lvl.faces.size()); ++f) {
+		if (owned[f] && !isRegularFace(lvl.topology, lvl.faces[f])) {
+			const Vec4i &face = lvl.faces[f];
+			used[face[0]] = used[face[1]] = used[face[2]] = used[face[3]] = 1;
+			faces.push_back(face);
+			faceOrigins.push_back(lvl.origins[f]);
+		}
+	}
+
+	Vec<int> vertMap(used.begin(), used.end());
+	ps.resize(parallelScan(vertMap));
+	normals.resize(ps.size());
+	parallelFor(vertCount, [&](int begin, int end) {
+		for (int v = begin; v < end; ++v) {
+			if (used[v]) {
+				ps[vertMap[v]] = limitPosition(lvl.faces, lvl.topology, lvl.ps, v);
+				normals[vertMap[v]] = limitNormal(lvl.faces, lvl.topology, lvl.ps, v);
+			}
+		}
+	});
+	for (Vec4i &face : faces) {
+		face = { vertMap[face[0]], vertMap[face[1]], vertMap[face[2]], vertMap[face[3]] };
+	}
+}
+
+/*
+============================================================================================
+ Tessellation
+============================================================================================
+*/
+void AdaptiveMesh::tessellate(int rate, Vec<Vec3> &outPs, Vec<Vec3> &outNormals, Vec<Vec4i> &outFaces) const {
+	rate = patchRate(rate);
+	const int patchCount = int(patches.size());
+
+	Vec<int> vertOffsets(patchCount);
+	Vec<int> faceOffsets(patchCount);
+	parallelFor(patchCount, [&](int begin, int end) {
+		for (int i = begin; i < end; ++i) {
+			const int segs = rate << (levels - patches[i].origin.level);
+			vertOffsets[i] = (segs + 1) * (segs + 1);
+			faceOffsets[i] = segs * segs;
+		}
+	});
+	const int patchVerts = parallelScan(vertOffsets);
+	const int patchFaces = parallelScan(faceOffsets);
+
+	outPs.resize(patchVerts + ps.size());
+	outNormals.resize(outPs.size());
+	outFaces.resize(patchFaces + faces.size());
+
+	parallelFor(patchCount, [&](int begin, int end) {
+		Vec<Vec4> basis, derivs;
+		for (int i = begin; i < end; ++i) {
+			const BSplinePatch &patch = patches[i];
+			const int segs = rate << (levels - patch.origin.level);
+			const float step = 1.f / float(segs);
+
+			basis.resize(segs + 1);
+			derivs.resize(segs + 1);
+			for (int k = 0; k <= segs; ++k) {
+				basis[k] = bsplineBasis(k * step);
+				derivs[k] = bsplineDerivBasis(k * step);
+			}
+
+			Vec3 *verts = &outPs[vertOffsets[i]];
+			Vec3 *norms = &outNormals[vertOffsets[i]];
+			for (int r = 0; r <= segs; ++r) {
+				Vec3 q[4], dq[4];
+				collapseRows(patch, basis[r], q);
+				collapseRows(patch, derivs[r], dq);
+				for (int c = 0; c <= segs; ++c) {
+					const Vec4 &bu = basis[c];
+					const Vec4 &dbu = derivs[c];
+					const Vec3 du = dbu[0] * q[0] + dbu[1] * q[1] + dbu[2] * q[2] + dbu[3] * q[3];
+					const Vec3 dv = bu[0] * dq[0] + bu[1] * dq[1] + bu[2] * dq[2] + bu[3] * dq[3];
+					verts[r * (segs + 1) + c] = bu[0] * q[0] + bu[1] * q[1] + bu[2] * q[2] + bu[3] * q[3];
+					norms[r * (segs + 1) + c] = glm::normalize(glm::cross(du, dv));
+				}
+			}
+
+			// Same winding as the face: u goes from vertex 0 to 1, v from vertex 0 to 3
+			Vec4i *quads = &outFaces[faceOffsets[i]];
+			for (int r = 0; r < segs; ++r) {
+				for (int c = 0; c < segs; ++c) {
+					const int v = vertOffsets[i] + r * (segs + 1) + c;
+					quads[r * segs + c] = { v, v + 1, v + segs + 2, v + segs + 1 };
+				}
+			}
+		}
+	}, 16);
+
+	std::copy(ps.begin(), ps.end(), outPs.begin() + patchVerts);
+	std::copy(normals.begin(), normals.end(), outNormals.begin() + patchVerts);
+	for (int f = 0; f < int(faces.size()); ++f) {
+		outFaces[patchFaces + f] = faces[f] + Vec4i(patchVerts);
+	}
+}
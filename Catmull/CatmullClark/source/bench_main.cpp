@@ -0,0 +1,386 @@
+// Headless benchmark of Mesh::subdivide, built by SubdivisionBench.vcxproj without GL.
+//
+// SubdivisionBench [--cage cube|grid:N|torus|file.obj|file.ply] [--levels L] [--threads T] [--repeats R]
+//                  [--engine global|tiled] [--cache MB] [--export level.ply|level.ccm] [--out results.json]
+//
+// Subdivides the cage level by level and writes, per level, the best time of the repeats, faces per
+// second, the allocations made by the step, the peak resident memory so far and a checksum of the
+// positions. Built-in cages have golden checksums: a level that does not match fails the run.
+// With --export the last level of the first repeat is written, see mesh_export.h, with its MB/s.
+// The timers and counters of each level's phases follow unless built without SUBDIVISION_PROFILE.
+
+// C std
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// C++ std
+#include <atomic>
+#include <chrono>
+#include <new>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>
+#endif
+
+#include "mesh.h"
+#include "mesh_import.h"
+#include "parallel.h"
+
+/*
+============================================================================================
+ Allocation counting
+============================================================================================
+*/
+std::atomic<long long> allocationCount{ 0 };
+std::atomic<long long> allocatedBytes{ 0 };
+
+// Every replacement operator goes through this pair, so each free meets the malloc it pairs with
+// instead of GCC seeing free called on what operator new returned (-Wmismatched-new-delete)
+void* countedAlloc(size_t size) {
+	++allocationCount;
+	allocatedBytes += size;
+	if (void *p = malloc(size ? size : 1)) {
+		return p;
+	}
+	throw std::bad_alloc();
+}
+
+void countedFree(void *p) noexcept {
+	free(p);
+}
+
+void* operator new(size_t size) {
+	return countedAlloc(size);
+}
+
+void* operator new[](size_t size) {
+	return countedAlloc(size);
+}
+
+void operator delete(void *p) noexcept {
+	countedFree(p);
+}
+
+void operator delete[](void *p) noexcept {
+	countedFree(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+	countedFree(p);
+}
+
+void operator delete[](void *p, size_t) noexcept {
+	countedFree(p);
+}
+
+size_t peakRssBytes() {
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+	return counters.PeakWorkingSetSize;
+#else
+	rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+	return size_t(usage.ru_maxrss);
+#else
+	return size_t(usage.ru_maxrss) << 10;
+#endif
+#endif
+}
+
+/*
+============================================================================================
+ Cages
+============================================================================================
+*/
+// The unit cube of newDefaultCube, same vertex and face order
+void makeCube(Vec<Vec3> &ps, Vec<Vec4i> &faces) {
+	ps = {
+		{ -0.5f, -0.5f,  0.5f }, {  0.5f, -0.5f,  0.5f }, {  0.5f,  0.5f,  0.5f }, { -0.5f,  0.5f,  0.5f },
+		{ -0.5f, -0.5f, -0.5f }, {  0.5f, -0.5f, -0.5f }, {  0.5f,  0.5f, -0.5f }, { -0.5f,  0.5f, -0.5f },
+	};
+	faces = {
+		{ 0, 1, 2, 3 }, { 1, 5, 6, 2 }, { 4, 5, 1, 0 }, { 3, 2, 6, 7 }, { 5, 4, 7, 6 }, { 4, 0, 3, 7 },
+	};
+}
+
+// n x n quads over [-0.5, 0.5]^2 with a wave on top
+void makeGrid(int n, Vec<Vec3> &ps, Vec<Vec4i> &faces) {
+	ps.clear();
+	faces.clear();
+	for (int y = 0; y <= n; ++y) {
+		for (int x = 0; x <= n; ++x) {
+			const float u = x / float(n) - 0.5f, v = y / float(n) - 0.5f;
+			ps.push_back({ u, v, 0.1f * std::sin(6.f * u) * std::cos(4.f * v) });
+		}
+	}
+	for (int y = 0; y < n; ++y) {
+		for (int x = 0; x < n; ++x) {
+			const int v = y * (n + 1) + x;
+			faces.push_back({ v, v + 1, v + n + 2, v + n + 1 });
+		}
+	}
+}
+
+// Closed torus of rings x sides quads, all vertices regular
+void makeTorus(int rings, int sides, Vec<Vec3> &ps, Vec<Vec4i> &faces) {
+	const float R = 0.35f, r = 0.15f, TAU = 6.28318531f;
+	ps.clear();
+	faces.clear();
+	for (int i = 0; i < rings; ++i) {
+		for (int j = 0; j < sides; ++j) {
+			const float a = TAU * i / rings, b = TAU * j / sides;
+			ps.push_back({ (R + r * std::cos(b)) * std::cos(a), (R + r * std::cos(b)) * std::sin(a), r * std::sin(b) });
+		}
+	}
+	for (int i = 0; i < rings; ++i) {
+		for (int j = 0; j < sides; ++j) {
+			const int i1 = (i + 1) % rings, j1 = (j + 1) % sides;
+			faces.push_back({ i * sides + j, i1 * sides + j, i1 * sides + j1, i * sides + j1 });
+		}
+	}
+}
+
+/*
+============================================================================================
+ Checksum
+============================================================================================
+*/
+// Sums that do not depend on the order of the vertices or faces, so that engines and vertex orders
+// compare: the norms, the squared norms and the squared norms of the face centroids
+struct Checksum {
+	double norms = 0.0;
+	double squares = 0.0;
+	double centroids = 0.0;
+};
+
+Checksum checksumOf(const Vec<Vec3> &ps, const Vec<Vec4i> &faces) {
+	Checksum c;
+	for (const Vec3 &p : ps) {
+		c.norms += double(glm::length(p));
+		c.squares += double(glm::dot(p, p));
+	}
+	for (const Vec4i &face : faces) {
+		const Vec3 centroid = 0.25f * (ps[face[0]] + ps[face[1]] + ps[face[2]] + ps[face[3]]);
+		c.centroids += double(glm::dot(centroid, centroid));
+	}
+	return c;
+}
+
+struct Golden {
+	const char *cage;
+	int level;
+	Checksum checksum;
+};
+
+// Levels 1 to 5 of the built-in cages, recorded with the global engine. The tiled engine matches them.
+const Golden GOLDEN[] = {
+	{ "cube", 1, { 13.21296263, 6.72685194, 4.779514074 } },
+	{ "cube", 2, { 43.8195585, 19.59501085, 17.97979569 } },
+	{ "cube", 3, { 167.0735195, 72.31903622, 70.77250612 } },
+	{ "cube", 4, { 660.2662661, 283.4714832, 281.9407879 } },
+	{ "cube", 5, { 2633.076964, 1128.139833, 1126.612931 } },
+	{ "grid:16", 1, { 433.2585544, 194.8581849, 172.5181024 } },
+	{ "grid:16", 2, { 1656.39638, 734.1540893, 690.5208266 } },
+	{ "grid:16", 3, { 6475.539928, 2848.773346, 2762.528735 } },
+	{ "grid:16", 4, { 25605.25689, 11222.03695, 11050.55947 } },
+	{ "grid:16", 5, { 101830.395, 44544.63005, 44202.68215 } },
+	{ "torus", 1, { 417.3766725, 162.7133811, 161.6612196 } },
+	{ "torus", 2, { 1665.012546, 646.649729, 645.6059216 } },
+	{ "torus", 3, { 6655.572279, 2582.424902, 2581.38317 } },
+	{ "torus", 4, { 26617.81524, 10325.53297, 10324.49178 } },
+	{ "torus", 5, { 106466.7882, 41297.96718, 41296.92604 } },
+};
+
+// 0 if there is no golden checksum, 1 if it matches, -1 if it does not
+int checkGolden(const char *cage, int level, const Checksum &c) {
+	auto close = [](double a, double b) {
+		return std::fabs(a - b) <= 1e-6 * Max(1.0, Max(std::fabs(a), std::fabs(b)));
+	};
+	for (const Golden &g : GOLDEN) {
+		if (strcmp(g.cage, cage) == 0 && g.level == level) {
+			const Checksum &e = g.checksum;
+			return close(c.norms, e.norms) && close(c.squares, e.squares) && close(c.centroids, e.centroids) ? 1 : -1;
+		}
+	}
+	return 0;
+}
+
+/*
+============================================================================================
+ Benchmark
+============================================================================================
+*/
+struct LevelResult {
+	double ms = 0.0;
+	long long faces = 0;
+	long long allocations = 0;
+	long long allocatedBytes = 0;
+	size_t peakRss = 0;
+	Checksum checksum;
+	int golden = 0;
+};
+
+int usage() {
+	fprintf(stderr, "usage: SubdivisionBench [--cage cube|grid:N|torus|file.obj|file.ply] [--levels L] [--threads T] "
+		"[--repeats R] [--engine global|tiled] [--cache MB] [--export level.ply|level.ccm] [--out results.json]\n");
+	return 2;
+}
+
+int main(int argc, char **argv) {
+	const char *cage = "cube";
+	const char *outPath = nullptr;
+	const char *exportPath = nullptr;
+	int levels = 5;
+	int threads = threadCount();
+	int repeats = 3;
+	int cacheMB = -1; // Mesh default
+	SubdivisionEngine engine = SubdivisionEngine::Global;
+	for (int i = 1; i < argc; ++i) {
+		const bool hasValue = i + 1 < argc;
+		if (!strcmp(argv[i], "--cage") && hasValue) {
+			cage = argv[++i];
+		} else if (!strcmp(argv[i], "--levels") && hasValue) {
+			levels = atoi(argv[++i]);
+		} else if (!strcmp(argv[i], "--threads") && hasValue) {
+			threads = atoi(argv[++i]);
+		} else if (!strcmp(argv[i], "--repeats") && hasValue) {
+			repeats = atoi(argv[++i]);
+		} else if (!strcmp(argv[i], "--engine") && hasValue) {
+			++i;
+			if (!strcmp(argv[i], "tiled")) {
+				engine = SubdivisionEngine::Tiled;
+			} else if (strcmp(argv[i], "global")) {
+				return usage();
+			}
+		} else if (!strcmp(argv[i], "--cache") && hasValue) {
+			cacheMB = atoi(argv[++i]);
+		} else if (!strcmp(argv[i], "--export") && hasValue) {
+			exportPath = argv[++i];
+		} else if (!strcmp(argv[i], "--out") && hasValue) {
+			outPath = argv[++i];
+		} else {
+			return usage();
+		}
+	}
+	if (levels < 1 || threads < 1 || repeats < 1) {
+		return usage();
+	}
+	setThreadCount(threads);
+
+	Vec<Vec3> cagePs;
+	Vec<Vec4i> cageFaces;
+	double importMs = 0.0;
+	if (!strcmp(cage, "cube")) {
+		makeCube(cagePs, cageFaces);
+	} else if (!strncmp(cage, "grid:", 5) && atoi(cage + 5) > 0) {
+		makeGrid(atoi(cage + 5), cagePs, cageFaces);
+	} else if (!strcmp(cage, "torus")) {
+		makeTorus(24, 12, cagePs, cageFaces);
+	} else {
+		// Faces other than quads are refined once with the quads, as Mesh::importMesh does
+		Polygons polygons;
+		const auto start = std::chrono::high_resolution_clock::now();
+		if (!importCage(cage, cagePs, cageFaces, polygons)) {
+			return usage();
+		}
+		importMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		if (polygons.count()) {
+			subdividePolygons(cagePs, cageFaces, polygons);
+		}
+	}
+
+	// Best time of the repeats, the rest from the first one
+	Vec<LevelResult> results(levels);
+	ExportStats exportStats;
+	bool exported = true;
+	SubdivisionProfile profile;
+	for (int r = 0; r < repeats; ++r) {
+		Mesh mesh;
+		mesh.ps = cagePs;
+		mesh.faces = cageFaces;
+		mesh.setEngine(engine);
+		if (cacheMB >= 0) {
+			mesh.setCacheBudget(size_t(cacheMB) << 20);
+		}
+
+		for (int l = 0; l < levels; ++l) {
+			LevelResult &result = results[l];
+			const long long allocations = allocationCount, bytes = allocatedBytes;
+			const auto start = std::chrono::high_resolution_clock::now();
+			mesh.subdivide();
+			const double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+			result.ms = r == 0 ? ms : Min(result.ms, ms);
+			if (r == 0) {
+				result.faces = (long long)mesh.quads().size();
+				result.allocations = allocationCount - allocations;
+				result.allocatedBytes = allocatedBytes - bytes;
+				result.peakRss = peakRssBytes();
+				result.checksum = checksumOf(mesh.ps, mesh.quads());
+				result.golden = checkGolden(cage, l + 1, result.checksum);
+			}
+		}
+		if (r == 0 && exportPath) {
+			exported = mesh.exportLevel(exportPath, &exportStats);
+		}
+		if (r == 0) {
+			profile = mesh.profile;
+		}
+	}
+
+	FILE *out = outPath ? fopen(outPath, "w") : stdout;
+	if (!out) {
+		fprintf(stderr, "SubdivisionBench: cannot write %s\n", outPath);
+		return 2;
+	}
+	bool passed = true;
+	fprintf(out, "{\n");
+	fprintf(out, "  \"cage\": \"%s\",\n", cage);
+	fprintf(out, "  \"cageVertices\": %d,\n", int(cagePs.size()));
+	fprintf(out, "  \"cageFaces\": %d,\n", int(cageFaces.size()));
+	fprintf(out, "  \"importMs\": %.3f,\n", importMs);
+	fprintf(out, "  \"engine\": \"%s\",\n", engine == SubdivisionEngine::Tiled ? "tiled" : "global");
+	fprintf(out, "  \"threads\": %d,\n", threads);
+	fprintf(out, "  \"repeats\": %d,\n", repeats);
+	fprintf(out, "  \"levels\": [\n");
+	for (int l = 0; l < levels; ++l) {
+		const LevelResult &r = results[l];
+		static const char *GOLDEN_NAMES[] = { "mismatch", "none", "ok" };
+		passed &= r.golden >= 0;
+		fprintf(out, "    { \"level\": %d, \"ms\": %.3f, \"faces\": %lld, \"facesPerSecond\": %.0f, "
+			"\"allocations\": %lld, \"allocatedBytes\": %lld, \"peakRssBytes\": %zu, "
+			"\"checksum\": [%.10g, %.10g, %.10g], \"golden\": \"%s\" }%s\n",
+			l + 1, r.ms, r.faces, r.ms > 0.0 ? r.faces / (r.ms * 1e-3) : 0.0,
+			r.allocations, r.allocatedBytes, r.peakRss,
+			r.checksum.norms, r.checksum.squares, r.checksum.centroids, GOLDEN_NAMES[r.golden + 1],
+			l + 1 < levels ? "," : "");
+	}
+	fprintf(out, "  ],\n");
+	if (exportPath) {
+		passed &= exported;
+		fprintf(out, "  \"export\": { \"path\": \"%s\", \"bytes\": %zu, \"ms\": %.3f, \"syncMs\": %.3f, \"mbPerSecond\": %.1f, \"ok\": %s },\n",
+			exportPath, exportStats.bytes, exportStats.ms, exportStats.syncMs, exportStats.mbPerSecond(), exported ? "true" : "false");
+	}
+#if SUBDIVISION_PROFILE
+	// The phases of each level, from the first repeat
+	fprintf(out, "  \"profile\": ");
+	profile.writeJson(out, "  ");
+	fprintf(out, ",\n");
+#endif
+	fprintf(out, "  \"peakRssBytes\": %zu,\n", peakRssBytes());
+	fprintf(out, "  \"passed\": %s\n", passed ? "true" : "false");
+	fprintf(out, "}\n");
+	if (outPath) {
+		fclose(out);
+	}
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,372 @@
+#include "benchmark.h"
+
+// C std
+#include <cmath>
+#include <cstring>
+
+// C++ std
+#include <chrono>
+#include <fstream>
+#include <sstream>
+
+#include "mesh_import.h"
+#include "spatial_order.h"
+#include "subdivision_kernels.h"
+#include "tiled_subdivision.h"
+#include "topology.h"
+#include "topology_cache.h"
+
+using std::chrono::duration;
+using std::chrono::high_resolution_clock;
+
+// One step of SubdivisionJob::runUniform, in place
+void globalStep(Vec<Vec3> &ps, Vec<Vec4i> &faces, Topology &topology) {
+	PointsSoA oldPs, outPs;
+	oldPs.fromAoS(ps);
+	outPs.resize(topology.vertCount + topology.faceCount() + topology.edgeCount());
+	findFacePoints(faces, oldPs, outPs);
+	findEdgePoints(topology, oldPs, outPs);
+	updatePoints(topology, oldPs, outPs);
+	outPs.toAoS(ps);
+
+	Vec<Vec4i> newFaces;
+	Topology newTopology;
+	refineTopology(faces, topology, newFaces, newTopology);
+	faces.swap(newFaces);
+	topology = std::move(newTopology);
+}
+
+// The points of globalStep alone, the connectivity of the next level is that of the refinement
+void sharedStep(RefinementTopology &refinement, int level, Vec<Vec3> &ps) {
+	const TopologyLevel &parent = refinement.level(level);
+	PointsSoA oldPs, outPs;
+	oldPs.fromAoS(ps);
+	outPs.resize(parent.topology.vertCount + parent.topology.faceCount() + parent.topology.edgeCount());
+	findFacePoints(parent.faces, oldPs, outPs);
+	findEdgePoints(parent.topology, oldPs, outPs);
+	updatePoints(parent.topology, oldPs, outPs);
+	outPs.toAoS(ps);
+	refinement.level(level + 1);
+}
+
+// The level-by-level loop of SubdivisionJob::runUniform, each level reordered if asked
+void globalSubdivide(const Vec<Vec3> &cagePs, const Vec<Vec4i> &cageFaces, int level, Vec<Vec3> &ps, Vec<Vec4i> &faces,
+	Topology &topology, bool reorder = false) {
+	ps = cagePs;
+	faces = cageFaces;
+	buildTopology(faces, ps.size(), topology);
+	for (int l = 0; l < level; ++l) {
+		globalStep(ps, faces, topology);
+		if (reorder) {
+			Vec<int> vertOrder;
+			spatialOrder(ps, vertOrder);
+			reorderVertices(vertOrder, ps, faces, topology);
+		}
+	}
+}
+
+// Cache lines missed per triangle when fetching the positions of the vertices in draw order,
+// through a 4-way set associative LRU cache of cacheBytes with 64 byte lines
+float vertexFetchMissRatio(const Vec<Vec4i> &faces, size_t cacheBytes = size_t(32) << 10) {
+	const int LINE = 64;
+	const int WAYS = 4;
+	const size_t sets = cacheBytes / (LINE * WAYS);
+	Vec<long long> lines(sets * WAYS, -1); // most recent first in every set
+	long long misses = 0;
+	for (const Vec4i &face : faces) {
+		for (int j : { 0, 1, 2, 0, 2, 3 }) { // the two triangles of triangulate
+			const long long line = (long long)face[j] * sizeof(Vec3) / LINE;
+			long long *set = &lines[(line % sets) * WAYS];
+			int way = 0;
+			while (way < WAYS - 1 && set[way] != line) {
+				++way;
+			}
+			misses += set[way] != line;
+			for (; way > 0; --way) {
+				set[way] = set[way - 1];
+			}
+			set[0] = line;
+		}
+	}
+	return faces.empty() ? 0.f : float(misses) / float(2 * faces.size());
+}
+
+// Milliseconds f takes
+template <class F>
+double timeOf(F f) {
+	const auto start = high_resolution_clock::now();
+	f();
+	return duration<double, std::milli>(high_resolution_clock::now() - start).count();
+}
+
+// Least of the times f returns, f leaves its setup out of them
+template <class F>
+double bestOf(int repeats, F f) {
+	double best = 0.0;
+	for (int r = 0; r < repeats; ++r) {
+		const double ms = f();
+		best = r == 0 ? ms : Min(best, ms);
+	}
+	return best;
+}
+
+EngineTimings benchmarkEngines(const Vec<Vec3> &cagePs, const Vec<Vec4i> &cageFaces, int level, int repeats) {
+	EngineTimings timings;
+	timings.level = level;
+
+	Vec<Vec3> ps;
+	Vec<Vec4i> faces;
+	Topology topology;
+	timings.globalMs = bestOf(repeats, [&] { return timeOf([&] { globalSubdivide(cagePs, cageFaces, level, ps, faces, topology); }); });
+	timings.tiledMs = bestOf(repeats, [&] { return timeOf([&] { tiledSubdivide(cagePs, cageFaces, level, ps, faces); }); });
+	return timings;
+}
+
+OrderTimings benchmarkSpatialOrder(const Vec<Vec3> &cagePs, const Vec<Vec4i> &cageFaces, int level, int repeats) {
+	OrderTimings timings;
+	timings.level = level;
+
+	// The same level in refinement order and sorted at every level
+	Vec<Vec3> ps[2];
+	Vec<Vec4i> faces[2];
+	Topology topology[2];
+	for (int i = 0; i < 2; ++i) {
+		globalSubdivide(cagePs, cageFaces, level, ps[i], faces[i], topology[i], i == 1);
+	}
+	timings.plainFetchMisses = vertexFetchMissRatio(faces[0]);
+	timings.orderedFetchMisses = vertexFetchMissRatio(faces[1]);
+
+	double *nextMs[2] = { &timings.plainMs, &timings.orderedMs };
+	for (int i = 0; i < 2; ++i) {
+		*nextMs[i] = bestOf(repeats, [&] {
+			Vec<Vec3> nextPs = ps[i];
+			Vec<Vec4i> nextFaces = faces[i];
+			Topology nextTopology = topology[i];
+			return timeOf([&] { globalStep(nextPs, nextFaces, nextTopology); });
+		});
+	}
+
+	// Sorting the next level, the cost of the pass itself
+	timings.reorderMs = bestOf(repeats, [&] {
+		Vec<Vec3> nextPs = ps[1];
+		Vec<Vec4i> nextFaces = faces[1];
+		Topology nextTopology = topology[1];
+		globalStep(nextPs, nextFaces, nextTopology);
+		return timeOf([&] {
+			Vec<int> vertOrder;
+			spatialOrder(nextPs, vertOrder);
+			reorderVertices(vertOrder, nextPs, nextFaces, nextTopology);
+		});
+	});
+	return timings;
+}
+
+SharedTopologyTimings benchmarkSharedTopology(const Vec<Vec3> &cagePs, const Vec<Vec4i> &cageFaces, int level, int repeats) {
+	SharedTopologyTimings timings;
+	timings.level = level;
+
+	Vec<Vec3> ps;
+	Vec<Vec4i> faces;
+	Vec<Vec3i> triFaces;
+	Topology topology;
+	timings.ownMs = bestOf(repeats, [&] {
+		return timeOf([&] {
+			ps = cagePs;
+			faces = cageFaces;
+			buildTopology(faces, ps.size(), topology);
+			for (int l = 0; l < level; ++l) {
+				globalStep(ps, faces, topology);
+				triangulate(faces, triFaces);
+			}
+		});
+	});
+
+	// Refined up front, as it is for a second mesh with the same cage faces
+	std::shared_ptr<RefinementTopology> refinement = sharedTopology(cageFaces, cagePs.size());
+	refinement->level(level);
+	timings.sharedMs = bestOf(repeats, [&] {
+		return timeOf([&] {
+			ps = cagePs;
+			for (int l = 0; l < level; ++l) {
+				sharedStep(*refinement, l, ps);
+			}
+		});
+	});
+	return timings;
+}
+
+/*
+============================================================================================
+ Import
+============================================================================================
+*/
+void addFace(const Vec<int> &face, Vec<Vec4i> &quads, Polygons &polygons) {
+	if (face.size() == 4) {
+		quads.push_back({ face[0], face[1], face[2], face[3] });
+		return;
+	}
+	if (polygons.offsets.empty()) {
+		polygons.offsets.push_back(0);
+	}
+	polygons.verts.insert(polygons.verts.end(), face.begin(), face.end());
+	polygons.offsets.push_back(polygons.verts.size());
+}
+
+bool streamImportObj(const char *path, Vec<Vec3> &ps, Vec<Vec4i> &quads, Polygons &polygons) {
+	std::ifstream in(path);
+	String line, keyword, token;
+	Vec<int> face;
+	while (std::getline(in, line)) {
+		std::istringstream words(line);
+		if (!(words >> keyword)) {
+			continue;
+		}
+		if (keyword == "v") {
+			Vec3 p;
+			words >> p.x >> p.y >> p.z;
+			ps.push_back(p);
+		} else if (keyword == "f") {
+			face.clear();
+			while (words >> token) {
+				const int i = std::stoi(token);
+				face.push_back(i > 0 ? i - 1 : int(ps.size()) + i);
+			}
+			addFace(face, quads, polygons);
+		}
+	}
+	return !ps.empty();
+}
+
+// Little endian files with the vertex element then the face element only
+bool streamImportPly(const char *path, Vec<Vec3> &ps, Vec<Vec4i> &quads, Polygons &polygons) {
+	struct Property {
+		String name;
+		int size = 0;
+		bool real = false;
+		bool sign = false;
+	};
+	auto property = [](const String &type, const String &name) {
+		static const char *TYPES[] = {
+			"char", "uchar", "short", "ushort", "int", "uint", "float", "double",
+			"int8", "uint8", "int16", "uint16", "int32", "uint32", "float32", "float64"
+		};
+		static const int SIZES[] = { 1, 1, 2, 2, 4, 4, 4, 8 };
+		Property p{ name };
+		for (int t = 0; t < 16; ++t) {
+			if (type == TYPES[t]) {
+				p.size = SIZES[t % 8];
+				p.real = t % 8 >= 6;
+				p.sign = t % 2 == 0;
+			}
+		}
+		return p;
+	};
+
+	std::ifstream in(path, std::ios::binary);
+	String line, keyword, element, format;
+	long long vertCount = 0, faceCount = 0;
+	Vec<Property> vertProps;
+	Property faceCountProp, faceIndexProp;
+	while (std::getline(in, line) && line.find("end_header") != 0) {
+		std::istringstream words(line);
+		words >> keyword;
+		if (keyword == "format") {
+			words >> format;
+		} else if (keyword == "element") {
+			long long count = 0;
+			words >> element >> count;
+			if (element == "vertex") {
+				vertCount = count;
+			} else if (element == "face") {
+				faceCount = count;
+			}
+		} else if (keyword == "property") {
+			String type, countType, indexType, name;
+			if (element == "vertex") {
+				words >> type >> name;
+				vertProps.push_back(property(type, name));
+			} else if (element == "face") {
+				words >> type >> countType >> indexType >> name;
+				faceCountProp = property(countType, name);
+				faceIndexProp = property(indexType, name);
+			}
+		}
+	}
+	if (format != "binary_little_endian") {
+		return false;
+	}
+
+	auto read = [&](const Property &p) {
+		unsigned char bytes[8] = {};
+		in.read((char*)bytes, p.size);
+		if (p.real) {
+			if (p.size == 8) {
+				double v;
+				memcpy(&v, bytes, 8);
+				return v;
+			}
+			float v;
+			memcpy(&v, bytes, 4);
+			return double(v);
+		}
+		long long v = 0;
+		memcpy(&v, bytes, p.size);
+		if (p.sign && (bytes[p.size - 1] & 0x80)) {
+			v -= 1ll << (8 * p.size);
+		}
+		return double(v);
+	};
+	for (long long v = 0; v < vertCount; ++v) {
+		Vec3 p(0.f);
+		for (const Property &prop : vertProps) {
+			const double value = read(prop);
+			if (prop.name.size() == 1 && prop.name[0] >= 'x' && prop.name[0] <= 'z') {
+				p[prop.name[0] - 'x'] = float(value);
+			}
+		}
+		ps.push_back(p);
+	}
+	Vec<int> face;
+	for (long long f = 0; f < faceCount; ++f) {
+		face.resize(int(read(faceCountProp)));
+		for (int &i : face) {
+			i = int(read(faceIndexProp));
+		}
+		addFace(face, quads, polygons);
+	}
+	return bool(in);
+}
+
+ImportTimings benchmarkImport(const char *path, int repeats) {
+	ImportTimings timings;
+	Vec<Vec3> ps, streamPs;
+	Vec<Vec4i> quads, streamQuads;
+	Polygons polygons, streamPolygons;
+	bool mappedOk = false, streamOk = false;
+	timings.mappedMs = bestOf(repeats, [&] {
+		return timeOf([&] { mappedOk = importCage(path, ps, quads, polygons); });
+	});
+
+	const char *dot = strrchr(path, '.');
+	const bool ply = dot && (strcmp(dot, ".ply") == 0 || strcmp(dot, ".PLY") == 0);
+	timings.streamMs = bestOf(repeats, [&] {
+		streamPs.clear();
+		streamQuads.clear();
+		streamPolygons.clear();
+		return timeOf([&] {
+			streamOk = ply ? streamImportPly(path, streamPs, streamQuads, streamPolygons) :
+				streamImportObj(path, streamPs, streamQuads, streamPolygons);
+		});
+	});
+
+	timings.vertCount = ps.size();
+	timings.faceCount = quads.size() + polygons.count();
+	timings.match = mappedOk && streamOk && ps.size() == streamPs.size() && quads == streamQuads &&
+		polygons.offsets == streamPolygons.offsets && polygons.verts == streamPolygons.verts;
+	for (size_t v = 0; v < ps.size() && timings.match; ++v) {
+		for (int k = 0; k < 3; ++k) {
+			timings.match &= std::fabs(ps[v][k] - streamPs[v][k]) <= 1e-6f * Max(1.f, std::fabs(ps[v][k]));
+		}
+	}
+	return timings;
+}
@@ -0,0 +1,84 @@
+#include "grid_mesh.h"
+
+// C++ std
+#include <algorithm>
+
+void gridIndices(int level, Vec<unsigned int> &indices) {
+	const unsigned int n = 1u << level, row = n + 1;
+	resizeExact(indices, 6 * n * n);
+	unsigned int *out = indices.data();
+	for (unsigned int y = 0; y < n; ++y) {
+		for (unsigned int x = 0; x < n; ++x) {
+			const unsigned int q[4] = { y * row + x, y * row + x + 1, (y + 1) * row + x + 1, (y + 1) * row + x };
+			*out++ = q[0]; *out++ = q[1]; *out++ = q[2];
+			*out++ = q[0]; *out++ = q[2]; *out++ = q[3];
+		}
+	}
+}
+
+void GridMesh::init(const Vec<Vec4i> &faces, size_t cageVertCount, int lvl) {
+	level = lvl;
+	cageFaces = faces;
+	buildTopology(cageFaces, cageVertCount, cage);
+	slots.resize(cageFaces.size());
+	for (int f = 0; f < int(slots.size()); ++f) {
+		slots[f] = f;
+	}
+}
+
+void GridMesh::clear() {
+	*this = GridMesh{};
+}
+
+CageGrid GridMesh::grid() const {
+	CageGrid g;
+	g.init(cageFaces, cage, slots, level);
+	return g;
+}
+
+int GridMesh::vertex(int f, int x, int y) const {
+	bool owner;
+	return int(grid().vertex(f, x, y, owner));
+}
+
+void GridMesh::quads(Vec<Vec4i> &faces) const {
+	const CageGrid g = grid();
+	const int n = int(g.n);
+	resizeExact(faces, g.quadCount());
+	bool owner;
+	for (int f = 0; f < int(cageFaces.size()); ++f) {
+		Vec4i *out = &faces[size_t(f) * n * n];
+		for (int y = 0; y < n; ++y) {
+			for (int x = 0; x < n; ++x) {
+				out[y * n + x] = {
+					int(g.vertex(f, x, y, owner)), int(g.vertex(f, x + 1, y, owner)),
+					int(g.vertex(f, x + 1, y + 1, owner)), int(g.vertex(f, x, y + 1, owner))
+				};
+			}
+		}
+	}
+}
+
+void GridMesh::patchPoints(const Vec<Vec3> &ps, int f, Vec3 *out) const {
+	const CageGrid g = grid();
+	const int n = int(g.n);
+	bool owner;
+	for (int y = 0; y <= n; ++y) {
+		const bool border = y == 0 || y == n;
+		for (int x = 0; x <= n; ++x) {
+			// Inner points of a row are consecutive
+			if (!border && x == 1) {
+				const Vec3 *inner = &ps[g.vertex(f, 1, y, owner)];
+				std::copy(inner, inner + n - 1, out);
+				out += n - 1;
+				x = n - 1;
+				continue;
+			}
+			*out++ = ps[g.vertex(f, x, y, owner)];
+		}
+	}
+}
+
+size_t GridMesh::bytes() const {
+	return bytesOf(cageFaces) + cage.bytes() + bytesOf(slots);
+}
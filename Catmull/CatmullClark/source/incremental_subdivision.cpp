@@ -0,0 +1,104 @@
+#include "incremental_subdivision.h"
+
+// C++ std
+#include <algorithm>
+
+#include "mesh.h"
+#include "parallel.h"
+#include "stencil_table.h"
+
+// Ranges closer than this many vertices are uploaded as one
+const int RANGE_GAP = 64;
+// Past this many ranges a single one spanning all is uploaded
+const int MAX_RANGES = 256;
+
+// Collects indices once each, in the order they are first added
+struct IndexSet {
+	Vec<char> marked;
+	Vec<int> &out;
+
+public:
+	IndexSet(int count, Vec<int> &list) : marked(count, 0), out(list) { out.clear(); }
+	void add(int i) {
+		if (!marked[i]) {
+			marked[i] = 1;
+			out.push_back(i);
+		}
+	}
+};
+
+void addRing(const Vec<Vec4i> &faces, const Topology &topology, const Vec<int> &dirty, IndexSet &set) {
+	for (int v : dirty) {
+		set.add(v); // isolated vertices have no faces
+		for (int i = topology.vertFaceOffsets[v]; i < topology.vertFaceOffsets[v + 1]; ++i) {
+			const Vec4i &face = faces[topology.vertFaces[i]];
+			for (int j = 0; j < Mesh::QUAD_FACE_VERTS; ++j) {
+				set.add(face[j]);
+			}
+		}
+	}
+}
+
+void vertexRing(const Vec<Vec4i> &faces, const Topology &topology, const Vec<int> &dirty, Vec<int> &ring) {
+	IndexSet set(topology.vertCount, ring);
+	addRing(faces, topology, dirty, set);
+	std::sort(ring.begin(), ring.end());
+}
+
+void dirtyChildren(const Vec<Vec4i> &faces, const Topology &topology, const Vec<int> &dirty, Vec<int> &children) {
+	const int n = topology.vertCount;
+	const int m = topology.faceCount();
+	IndexSet set(n + m + topology.edgeCount(), children);
+	addRing(faces, topology, dirty, set);
+	for (int v : dirty) {
+		for (int i = topology.vertFaceOffsets[v]; i < topology.vertFaceOffsets[v + 1]; ++i) {
+			const int f = topology.vertFaces[i];
+			set.add(n + f);
+			for (int j = 0; j < Mesh::QUAD_FACE_VERTS; ++j) {
+				set.add(n + m + topology.faceEdges[f][j]);
+			}
+		}
+	}
+	std::sort(children.begin(), children.end());
+}
+
+void refineVertices(const Vec<Vec4i> &faces, const Topology &topology, const Vec<Vec3> &ps, const Vec<int> &children,
+	const Vec<int> &order, Vec<Vec3> &childPs) {
+	parallelFor(children.size(), [&](int begin, int end) {
+		Vec<Weight> rule;
+		for (int i = begin; i < end; ++i) {
+			childWeights(faces, topology, children[i], rule);
+			Vec3 acc{ 0.f, 0.f, 0.f };
+			for (const Weight &w : rule) {
+				acc += w.weight * ps[w.vert];
+			}
+			childPs[order.empty() ? children[i] : order[children[i]]] = acc;
+		}
+	}, 1024);
+}
+
+void addDirtyRanges(const Vec<int> &verts, Vec<Vec2i> &ranges) {
+	for (int v : verts) {
+		if (!ranges.empty() && ranges.back().y + RANGE_GAP >= v && ranges.back().x <= v) {
+			ranges.back().y = Max(ranges.back().y, v + 1);
+		} else {
+			ranges.push_back({ v, v + 1 });
+		}
+	}
+
+	// Ranges of earlier edits come first, sort and join again
+	std::sort(ranges.begin(), ranges.end(), [](const Vec2i &a, const Vec2i &b) { return a.x < b.x; });
+	int count = 0;
+	for (const Vec2i &r : ranges) {
+		if (count > 0 && ranges[count - 1].y + RANGE_GAP >= r.x) {
+			ranges[count - 1].y = Max(ranges[count - 1].y, r.y);
+		} else {
+			ranges[count++] = r;
+		}
+	}
+	ranges.resize(count);
+
+	if (count > MAX_RANGES) {
+		ranges = { { ranges.front().x, ranges.back().y } };
+	}
+}
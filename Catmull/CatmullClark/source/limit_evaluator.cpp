@@ -0,0 +1,211 @@
+#include "limit_evaluator.h"
+
+// C std
+#include <climits>
+
+#include "adaptive_subdivision.h"
+#include "parallel.h"
+#include "simd.h"
+#include "subdivision_kernels.h"
+
+const int EMPTY_ENTRY = INT_MIN; // never happens for a well formed cage
+
+// Quadrant of child j, as in FaceOrigin::child
+inline int quadrant(int qx, int qy) {
+	return qy ? 3 - qx : qx;
+}
+
+void LimitEvaluator::build(const Vec<Vec3> &cagePs, const Vec<Vec4i> &cageFaces, int d) {
+	depth = d;
+
+	AdaptiveMesh adaptive;
+	adaptive.build(cagePs, cageFaces, depth);
+
+	const int patchCount = int(adaptive.patches.size());
+	const int cellCount = int(adaptive.faces.size());
+	patchCps.resize(16 * patchCount);
+	patchLevels.resize(patchCount);
+	cellCorners.resize(4 * cellCount);
+	cellLevels.resize(cellCount);
+
+	parallelFor(patchCount, [&](int begin, int end) {
+		for (int i = begin; i < end; ++i) {
+			for (int c = 0; c < 16; ++c) {
+				patchCps[16 * i + c] = Vec4(adaptive.patches[i].cps[c], 0.f);
+			}
+			patchLevels[i] = adaptive.patches[i].origin.level;
+		}
+	});
+	parallelFor(cellCount, [&](int begin, int end) {
+		for (int i = begin; i < end; ++i) {
+			for (int j = 0; j < 4; ++j) {
+				cellCorners[4 * i + j] = Vec4(adaptive.ps[adaptive.faces[i][j]], 0.f);
+			}
+			cellLevels[i] = adaptive.faceOrigins[i].level;
+		}
+	});
+
+	// Quadtrees, leaves are inserted along the path given by their origin
+	roots.assign(cageFaces.size(), EMPTY_ENTRY);
+	nodes.clear();
+	auto insert = [&](const FaceOrigin &origin, int leaf) {
+		int *slot = &roots[origin.face];
+		for (int l = 0; l < origin.level; ++l) {
+			int node = *slot;
+			if (node < 0) {
+				node = int(nodes.size());
+				*slot = node;
+				nodes.push_back(Vec4i(EMPTY_ENTRY));
+			}
+			const int shift = origin.level - 1 - l;
+			const int q = quadrant((origin.cell.x >> shift) & 1, (origin.cell.y >> shift) & 1);
+			slot = &nodes[node][q];
+		}
+		*slot = ~leaf;
+	};
+	for (int i = 0; i < patchCount; ++i) {
+		insert(adaptive.patches[i].origin, i);
+	}
+	for (int i = 0; i < cellCount; ++i) {
+		insert(adaptive.faceOrigins[i], patchCount + i);
+	}
+}
+
+/*
+============================================================================================
+ Leaves
+============================================================================================
+*/
+Vec3 evaluatePatchScalar(const Vec4 *cps, float s, float t, float scale, Vec3 *du, Vec3 *dv) {
+	const Vec4 bu = bsplineBasis(s);
+	const Vec4 bv = bsplineBasis(t);
+	const Vec4 dbu = bsplineDerivBasis(s);
+	const Vec4 dbv = bsplineDerivBasis(t);
+
+	Vec4 p{ 0.f }, pu{ 0.f }, pv{ 0.f };
+	for (int r = 0; r < 4; ++r) {
+		const Vec4 row = bu[0] * cps[4 * r] + bu[1] * cps[4 * r + 1] + bu[2] * cps[4 * r + 2] + bu[3] * cps[4 * r + 3];
+		const Vec4 rowU = dbu[0] * cps[4 * r] + dbu[1] * cps[4 * r + 1] + dbu[2] * cps[4 * r + 2] + dbu[3] * cps[4 * r + 3];
+		p += bv[r] * row;
+		pu += bv[r] * rowU;
+		pv += dbv[r] * row;
+	}
+
+	if (du) {
+		*du = Vec3(pu) * scale;
+	}
+	if (dv) {
+		*dv = Vec3(pv) * scale;
+	}
+	return Vec3(p);
+}
+
+#ifdef SIMD_X64
+// Same sums as the scalar version, one control point per SSE register
+Vec3 evaluatePatchSSE(const Vec4 *cps, float s, float t, float scale, Vec3 *du, Vec3 *dv) {
+	const Vec4 bu = bsplineBasis(s);
+	const Vec4 bv = bsplineBasis(t);
+	const Vec4 dbu = bsplineDerivBasis(s);
+	const Vec4 dbv = bsplineDerivBasis(t);
+
+	__m128 p = _mm_setzero_ps();
+	__m128 pu = _mm_setzero_ps();
+	__m128 pv = _mm_setzero_ps();
+	for (int r = 0; r < 4; ++r) {
+		__m128 row = _mm_setzero_ps();
+		__m128 rowU = _mm_setzero_ps();
+		for (int c = 0; c < 4; ++c) {
+			const __m128 cp = _mm_loadu_ps(&cps[4 * r + c].x);
+			row = _mm_add_ps(row, _mm_mul_ps(_mm_set1_ps(bu[c]), cp));
+			rowU = _mm_add_ps(rowU, _mm_mul_ps(_mm_set1_ps(dbu[c]), cp));
+		}
+		p = _mm_add_ps(p, _mm_mul_ps(_mm_set1_ps(bv[r]), row));
+		pu = _mm_add_ps(pu, _mm_mul_ps(_mm_set1_ps(bv[r]), rowU));
+		pv = _mm_add_ps(pv, _mm_mul_ps(_mm_set1_ps(dbv[r]), row));
+	}
+
+	alignas(16) float res[3][4];
+	_mm_store_ps(res[0], p);
+	_mm_store_ps(res[1], _mm_mul_ps(pu, _mm_set1_ps(scale)));
+	_mm_store_ps(res[2], _mm_mul_ps(pv, _mm_set1_ps(scale)));
+	if (du) {
+		*du = { res[1][0], res[1][1], res[1][2] };
+	}
+	if (dv) {
+		*dv = { res[2][0], res[2][1], res[2][2] };
+	}
+	return { res[0][0], res[0][1], res[0][2] };
+}
+#endif
+
+// Bilinear over the limit corners of a cell
+Vec3 evaluateCell(const Vec4 *corners, float s, float t, float scale, Vec3 *du, Vec3 *dv) {
+	const Vec3 p0(corners[0]), p1(corners[1]), p2(corners[2]), p3(corners[3]);
+	if (du) {
+		*du = ((1.f - t) * (p1 - p0) + t * (p2 - p3)) * scale;
+	}
+	if (dv) {
+		*dv = ((1.f - s) * (p3 - p0) + s * (p2 - p1)) * scale;
+	}
+	return (1.f - t) * ((1.f - s) * p0 + s * p1) + t * ((1.f - s) * p3 + s * p2);
+}
+
+/*
+============================================================================================
+ Evaluation
+============================================================================================
+*/
+Vec3 LimitEvaluator::evaluate(int face, float u, float v, Vec3 *du, Vec3 *dv) const {
+	float s = Min(Max(u, 0.f), 1.f);
+	float t = Min(Max(v, 0.f), 1.f);
+
+	int entry = roots[face];
+	while (entry >= 0) {
+		const int qx = s >= 0.5f;
+		const int qy = t >= 0.5f;
+		s = 2.f * s - qx;
+		t = 2.f * t - qy;
+		entry = nodes[entry][quadrant(qx, qy)];
+	}
+	if (entry == EMPTY_ENTRY) {
+		return Vec3{ 0.f, 0.f, 0.f };
+	}
+
+	// Derivatives are taken over the cage face, a leaf of level l spans 2^-l of it
+	const int leaf = ~entry;
+	const int patchCount = int(patchLevels.size());
+	if (leaf >= patchCount) {
+		const int cell = leaf - patchCount;
+		return evaluateCell(&cellCorners[4 * cell], s, t, float(1 << cellLevels[cell]), du, dv);
+	}
+
+	const Vec4 *cps = &patchCps[16 * leaf];
+	const float scale = float(1 << patchLevels[leaf]);
+#ifdef SIMD_X64
+	if (simdPath() != SimdPath::Scalar) {
+		return evaluatePatchSSE(cps, s, t, scale, du, dv);
+	}
+#endif
+	return evaluatePatchScalar(cps, s, t, scale, du, dv);
+}
+
+Vec3 LimitEvaluator::evaluate(const LimitQuery &query, Vec3 *du, Vec3 *dv) const {
+	return evaluate(query.face, query.u, query.v, du, dv);
+}
+
+void LimitEvaluator::evaluate(const Vec<LimitQuery> &queries, Vec<Vec3> &ps, Vec<Vec3> *du, Vec<Vec3> *dv) const {
+	const int count = int(queries.size());
+	ps.resize(count);
+	if (du) {
+		du->resize(count);
+	}
+	if (dv) {
+		dv->resize(count);
+	}
+
+	parallelFor(count, [&](int begin, int end) {
+		for (int i = begin; i < end; ++i) {
+			ps[i] = evaluate(queries[i], du ? &(*du)[i] : nullptr, dv ? &(*dv)[i] : nullptr);
+		}
+	}, 1024);
+}
@@ -0,0 +1,332 @@
+#include "limit_surface.h"
+
+// C std
+#include <cmath>
+
+// C++ std
+#include <utility>
+
+#include "parallel.h"
+
+// Other end of edge e from v
+inline int otherVert(const Topology &topology, int e, int v) {
+	const Vec2i edge = topology.edgeVerts[e];
+	return edge.x == v ? edge.y : edge.x;
+}
+
+inline int oppositeVert(const Vec4i &face, int v) {
+	return face[(localIndex(face, v) + 2) & 3];
+}
+
+Vec3 limitPosition(const Vec<Vec4i> &faces, const Topology &topology, const Vec<Vec3> &ps, int v) {
+	const Vec3 &p = ps[v];
+	if (topology.faceValence(v) == 0) {
+		return p;
+	}
+
+	const int eBegin = topology.vertEdgeOffsets[v];
+	const int eEnd = topology.vertEdgeOffsets[v + 1];
+
+	if (!topology.isBoundaryVert(v)) {
+		// (n^2 * P + 4 * sum of edge neighbors + sum of diagonal neighbors) / (n * (n + 5))
+		const float n = float(eEnd - eBegin);
+		Vec3 edgeSum{ 0.f, 0.f, 0.f };
+		for (int i = eBegin; i < eEnd; ++i) {
+			edgeSum += ps[otherVert(topology, topology.vertEdges[i], v)];
+		}
+		Vec3 diagSum{ 0.f, 0.f, 0.f };
+		for (int i = topology.vertFaceOffsets[v]; i < topology.vertFaceOffsets[v + 1]; ++i) {
+			diagSum += ps[oppositeVert(faces[topology.vertFaces[i]], v)];
+		}
+		return (n * n * p + 4.f * edgeSum + diagSum) / (n * (n + 5.f));
+	}
+
+	// The boundary rules (4P + a + b) / 6 and midpoints converge to (a + 3P + b) / 5
+	Vec3 sum{ 0.f, 0.f, 0.f };
+	int cnt = 0;
+	for (int i = eBegin; i < eEnd; ++i) {
+		const int e = topology.vertEdges[i];
+		if (topology.isBoundaryEdge(e)) {
+			sum += ps[otherVert(topology, e, v)];
+			++cnt;
+		}
+	}
+	return cnt == 2 ? (sum + 3.f * p) / 5.f : p;
+}
+
+// Sum of the normals of the faces around v
+Vec3 faceNormalSum(const Vec<Vec4i> &faces, const Topology &topology, const Vec<Vec3> &ps, int v) {
+	Vec3 sum{ 0.f, 0.f, 0.f };
+	for (int i = topology.vertFaceOffsets[v]; i < topology.vertFaceOffsets[v + 1]; ++i) {
+		const Vec4i &face = faces[topology.vertFaces[i]];
+		const int k = localIndex(face, v);
+		sum += glm::cross(ps[face[(k + 1) & 3]] - ps[v], ps[face[(k + 3) & 3]] - ps[v]);
+	}
+	return sum;
+}
+
+inline Vec3 normalizeOr(const Vec3 &n, const Vec3 &fallback) {
+	const float len = glm::length(n);
+	return len > 0.f ? n / len : fallback;
+}
+
+// Tangent masks of an interior vertex of valence n: A_n * cos(2 pi i / n) for edge neighbor i and
+// cos(2 pi i / n) + cos(2 pi (i + 1) / n) for diagonal i, with A_n = 1 + cos(2 pi / n) + cos(pi / n) * sqrt(2 * (9 + cos(2 pi / n)))
+struct TangentMask {
+	Vec<float> edge;
+	Vec<float> diag;
+};
+
+void buildTangentMask(int n, TangentMask &mask) {
+	const double pi = 3.14159265358979323846;
+	const double A = 1.0 + std::cos(2.0 * pi / n) + std::cos(pi / n) * std::sqrt(2.0 * (9.0 + std::cos(2.0 * pi / n)));
+	mask.edge.resize(n);
+	mask.diag.resize(n);
+	for (int i = 0; i < n; ++i) {
+		mask.edge[i] = float(A * std::cos(2.0 * pi * i / n));
+		mask.diag[i] = float(std::cos(2.0 * pi * i / n) + std::cos(2.0 * pi * (i + 1) / n));
+	}
+}
+
+const int MAX_CACHED_VALENCE = 32;
+
+const TangentMask& tangentMask(int n) {
+	static const Vec<TangentMask> masks = [] {
+		Vec<TangentMask> result(MAX_CACHED_VALENCE + 1);
+		for (int i = 1; i <= MAX_CACHED_VALENCE; ++i) {
+			buildTangentMask(i, result[i]);
+		}
+		return result;
+	}();
+	if (n <= MAX_CACHED_VALENCE) {
+		return masks[n];
+	}
+
+	thread_local TangentMask mask;
+	buildTangentMask(n, mask);
+	return mask;
+}
+
+// Cross boundary tangent mask of a boundary vertex with k edges, on the ring ordered as
+// [v, e_0 .. e_k-1, d_0 .. d_k-2] where e_0 and e_k-1 are on the border and face j is (v, e_j, d_j, e_j+1).
+// The boundary rules here are not the usual ones, so there are no closed form masks: this is the dominant
+// left eigenvector of the local subdivision matrix among the masks that are mirror symmetric and sum to 0.
+// The tangent along the border is e_k-1 - e_0.
+void buildBoundaryMask(int k, Vec<float> &mask) {
+	const int size = 2 * k;
+	Vec<double> S(size * size, 0.0);
+	auto rule = [&](int row, int col, double w) {
+		S[row * size + col] += w;
+	};
+	auto facePoint = [&](int row, int j, double w) {
+		rule(row, 0, w / 4.0);
+		rule(row, 1 + j, w / 4.0);
+		rule(row, 1 + j + 1, w / 4.0);
+		rule(row, k + 1 + j, w / 4.0);
+	};
+
+	// (4P + a + b) / 6 and midpoints on the border
+	rule(0, 0, 4.0 / 6.0);
+	rule(0, 1, 1.0 / 6.0);
+	rule(0, k, 1.0 / 6.0);
+	rule(1, 0, 0.5);
+	rule(1, 1, 0.5);
+	rule(k, 0, 0.5);
+	rule(k, k, 0.5);
+	for (int i = 1; i < k - 1; ++i) {
+		rule(1 + i, 0, 0.25);
+		rule(1 + i, 1 + i, 0.25);
+		facePoint(1 + i, i - 1, 0.25);
+		facePoint(1 + i, i, 0.25);
+	}
+	for (int j = 0; j < k - 1; ++j) {
+		facePoint(k + 1 + j, j, 1.0);
+	}
+
+	auto mirror = [&](int i) {
+		if (i == 0) {
+			return 0;
+		}
+		return i <= k ? k + 1 - i : 3 * k - i;
+	};
+
+	// Power iteration x <- x S, kept symmetric and summing to 0
+	Vec<double> x(size, 1.0), next(size);
+	x[0] = 1.0 - size;
+	for (int iter = 0; iter < 200; ++iter) {
+		for (int c = 0; c < size; ++c) {
+			next[c] = 0.0;
+			for (int r = 0; r < size; ++r) {
+				next[c] += x[r] * S[r * size + c];
+			}
+		}
+
+		double sum = 0.0;
+		for (int i = 0; i < size; ++i) {
+			x[i] = 0.5 * (next[i] + next[mirror(i)]);
+			sum += x[i];
+		}
+		double norm = 0.0;
+		for (int i = 0; i < size; ++i) {
+			x[i] -= sum / size;
+			norm += x[i] * x[i];
+		}
+		norm = std::sqrt(norm);
+		for (int i = 0; i < size; ++i) {
+			x[i] /= norm;
+		}
+	}
+
+	mask.assign(x.begin(), x.end());
+}
+
+const Vec<float>& boundaryMask(int k) {
+	static const Vec<Vec<float>> masks = [] {
+		Vec<Vec<float>> result(MAX_CACHED_VALENCE + 1);
+		for (int i = 2; i <= MAX_CACHED_VALENCE; ++i) {
+			buildBoundaryMask(i, result[i]);
+		}
+		return result;
+	}();
+	if (k <= MAX_CACHED_VALENCE) {
+		return masks[k];
+	}
+
+	thread_local Vec<float> mask;
+	buildBoundaryMask(k, mask);
+	return mask;
+}
+
+Vec3 boundaryNormal(const Vec<Vec4i> &faces, const Topology &topology, const Vec<Vec3> &ps, int v, const Vec3 &faceSum) {
+	const int k = topology.edgeValence(v);
+	const int eBegin = topology.vertEdgeOffsets[v];
+	const Vec3 fallback = normalizeOr(faceSum, { 0.f, 0.f, 1.f });
+
+	int start = -1;
+	for (int i = eBegin; i < eBegin + k; ++i) {
+		if (topology.isBoundaryEdge(topology.vertEdges[i])) {
+			start = topology.vertEdges[i];
+			break;
+		}
+	}
+	if (start < 0 || k < 2 || topology.faceValence(v) != k - 1) {
+		return fallback; // more than one fan of faces around v
+	}
+
+	// Walk the fan from one border edge to the other
+	const Vec<float> &mask = boundaryMask(k);
+	Vec3 cross = mask[0] * ps[v];
+	int f = topology.edgeFaces[start].x;
+	int e = otherVert(topology, start, v);
+	const Vec3 first = ps[e];
+	for (int j = 0; j < k - 1; ++j) {
+		const Vec4i &face = faces[f];
+		const int l = localIndex(face, v);
+		const int b = face[(l + 1) & 3] == e ? face[(l + 3) & 3] : face[(l + 1) & 3];
+		cross += mask[1 + j] * ps[e] + mask[k + 1 + j] * ps[face[(l + 2) & 3]];
+
+		int next = -1;
+		for (int i = eBegin; i < eBegin + k; ++i) {
+			const int edge = topology.vertEdges[i];
+			if (otherVert(topology, edge, v) == b) {
+				next = edge;
+				break;
+			}
+		}
+		if (next < 0) {
+			return fallback;
+		}
+		f = topology.otherFace(next, f);
+		e = b;
+		if ((f < 0) != (j == k - 2)) {
+			return fallback;
+		}
+	}
+	cross += mask[k] * ps[e];
+
+	const Vec3 normal = glm::cross(ps[e] - first, cross);
+	return normalizeOr(glm::dot(normal, faceSum) < 0.f ? -normal : normal, fallback);
+}
+
+Vec3 limitNormal(const Vec<Vec4i> &faces, const Topology &topology, const Vec<Vec3> &ps, int v) {
+	if (topology.faceValence(v) == 0) {
+		return { 0.f, 0.f, 1.f };
+	}
+
+	const Vec3 faceSum = faceNormalSum(faces, topology, ps, v);
+	const int n = topology.edgeValence(v);
+	const int eBegin = topology.vertEdgeOffsets[v];
+
+	if (topology.isBoundaryVert(v)) {
+		return boundaryNormal(faces, topology, ps, v, faceSum);
+	}
+
+	// Walk the faces around v in winding order. Edge neighbor i is followed by the diagonal
+	// of the face between edge neighbors i and i + 1.
+	const TangentMask &mask = tangentMask(n);
+	Vec3 t1{ 0.f, 0.f, 0.f };
+	Vec3 t2{ 0.f, 0.f, 0.f };
+
+	const int first = topology.vertFaces[topology.vertFaceOffsets[v]];
+	int f = first;
+	int edgeNeighbor = faces[f][(localIndex(faces[f], v) + 1) & 3];
+	for (int i = 0; i < n; ++i) {
+		const Vec4i &face = faces[f];
+		const int k = localIndex(face, v);
+		int a = face[(k + 1) & 3];
+		int b = face[(k + 3) & 3];
+		if (a != edgeNeighbor) {
+			std::swap(a, b); // neighbor face with the opposite winding
+		}
+		if (a != edgeNeighbor || (i > 0 && f == first)) {
+			return normalizeOr(faceSum, { 0.f, 0.f, 1.f }); // not a disk around v
+		}
+
+		// The second tangent is the first one rotated by one neighbor
+		const int prev = i == 0 ? n - 1 : i - 1;
+		const Vec3 &e = ps[a];
+		const Vec3 &d = ps[face[(k + 2) & 3]];
+		t1 += mask.edge[i] * e + mask.diag[i] * d;
+		t2 += mask.edge[prev] * e + mask.diag[prev] * d;
+
+		// Cross the edge to b
+		int next = -1;
+		for (int j = eBegin; j < eBegin + n; ++j) {
+			const int e = topology.vertEdges[j];
+			if (otherVert(topology, e, v) == b) {
+				next = topology.otherFace(e, f);
+				break;
+			}
+		}
+		if (next < 0) {
+			return normalizeOr(faceSum, { 0.f, 0.f, 1.f });
+		}
+		f = next;
+		edgeNeighbor = b;
+	}
+
+	const Vec3 normal = glm::cross(t1, t2);
+	return normalizeOr(glm::dot(normal, faceSum) < 0.f ? -normal : normal, normalizeOr(faceSum, { 0.f, 0.f, 1.f }));
+}
+
+void limitProject(const Vec<Vec4i> &faces, const Topology &topology, const Vec<Vec3> &ps, Vec<Vec3> &limitPs, Vec<Vec3> &normals) {
+	resizeExact(limitPs, ps.size());
+	resizeExact(normals, ps.size());
+	parallelFor(ps.size(), [&](int begin, int end) {
+		for (int v = begin; v < end; ++v) {
+			limitPs[v] = limitPosition(faces, topology, ps, v);
+			normals[v] = limitNormal(faces, topology, ps, v);
+		}
+	});
+}
+
+void limitProjectVertices(const Vec<Vec4i> &faces, const Topology &topology, const Vec<Vec3> &ps, const Vec<int> &verts,
+	Vec<Vec3> &limitPs, Vec<Vec3> &normals) {
+	parallelFor(verts.size(), [&](int begin, int end) {
+		for (int i = begin; i < end; ++i) {
+			const int v = verts[i];
+			limitPs[v] = limitPosition(faces, topology, ps, v);
+			normals[v] = limitNormal(faces, topology, ps, v);
+		}
+	}, 1024);
+}
@@ -20,6 +20,9 @@ extern UIEngine *ui;
 int main(int argc, char **argv) {
 	OpenGLInit();
 	UIInit(opengl->getGLFWwindow());
+	if (argc > 1) {
+		opengl->importMesh(argv[1]); // the cube stays if it cannot be read
+	}
 
 	mainLoop();
 
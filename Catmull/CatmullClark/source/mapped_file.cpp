@@ -0,0 +1,182 @@
+#include "mapped_file.h"
+
+// C std
+#include <cstdio>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile() {
+	close();
+}
+
+#ifdef _WIN32
+bool MappedFile::create(const char *path, size_t bytes) {
+	close();
+	file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE) {
+		file = nullptr;
+		fprintf(stderr, "MappedFile: cannot create %s\n", path);
+		return false;
+	}
+
+	const DWORD high = DWORD((unsigned long long)bytes >> 32);
+	const DWORD low = DWORD(bytes & 0xFFFFFFFFull);
+	mapping = CreateFileMappingA(file, nullptr, PAGE_READWRITE, high, low, nullptr);
+	data = mapping ? (char*)MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, bytes) : nullptr;
+	if (!data) {
+		fprintf(stderr, "MappedFile: cannot map %llu bytes of %s\n", (unsigned long long)bytes, path);
+		close();
+		return false;
+	}
+
+	size = bytes;
+	writable = true;
+	return true;
+}
+
+bool MappedFile::open(const char *path) {
+	close();
+	file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE) {
+		file = nullptr;
+		fprintf(stderr, "MappedFile: cannot open %s\n", path);
+		return false;
+	}
+
+	LARGE_INTEGER fileSize;
+	GetFileSizeEx(file, &fileSize);
+	mapping = fileSize.QuadPart ? CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+	data = mapping ? (char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+	if (!data) {
+		fprintf(stderr, "MappedFile: cannot map %s\n", path);
+		close();
+		return false;
+	}
+
+	size = size_t(fileSize.QuadPart);
+	writable = false;
+	return true;
+}
+
+void MappedFile::close() {
+	if (data) {
+		UnmapViewOfFile(data);
+	}
+	if (mapping) {
+		CloseHandle(mapping);
+	}
+	if (file) {
+		CloseHandle(file);
+	}
+	data = nullptr;
+	mapping = nullptr;
+	file = nullptr;
+	size = 0;
+}
+
+void MappedFile::release(size_t offset, size_t bytes) {
+	if (!data || offset >= size) {
+		return;
+	}
+
+	bytes = bytes < size - offset ? bytes : size - offset;
+	if (writable) {
+		FlushViewOfFile(data + offset, bytes);
+	}
+	// Unlocking pages that are not locked drops them from the working set
+	VirtualUnlock(data + offset, bytes);
+}
+#else
+bool MappedFile::create(const char *path, size_t bytes) {
+	close();
+	fd = ::open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		fprintf(stderr, "MappedFile: cannot create %s\n", path);
+		return false;
+	}
+
+	if (ftruncate(fd, off_t(bytes)) != 0) {
+		fprintf(stderr, "MappedFile: cannot grow %s to %llu bytes\n", path, (unsigned long long)bytes);
+		close();
+		return false;
+	}
+
+	void *ptr = bytes ? mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+	if (ptr == MAP_FAILED) {
+		fprintf(stderr, "MappedFile: cannot map %llu bytes of %s\n", (unsigned long long)bytes, path);
+		close();
+		return false;
+	}
+
+	data = (char*)ptr;
+	size = bytes;
+	writable = true;
+	return true;
+}
+
+bool MappedFile::open(const char *path) {
+	close();
+	fd = ::open(path, O_RDONLY);
+	if (fd < 0) {
+		fprintf(stderr, "MappedFile: cannot open %s\n", path);
+		return false;
+	}
+
+	struct stat info;
+	void *ptr = MAP_FAILED;
+	if (fstat(fd, &info) == 0 && info.st_size > 0) {
+		ptr = mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_SHARED, fd, 0);
+	}
+	if (ptr == MAP_FAILED) {
+		fprintf(stderr, "MappedFile: cannot map %s\n", path);
+		close();
+		return false;
+	}
+
+	data = (char*)ptr;
+	size = size_t(info.st_size);
+	writable = false;
+	return true;
+}
+
+void MappedFile::close() {
+	if (data) {
+		munmap(data, size);
+	}
+	if (fd >= 0) {
+		::close(fd);
+	}
+	data = nullptr;
+	fd = -1;
+	size = 0;
+}
+
+void MappedFile::release(size_t offset, size_t bytes) {
+	if (!data || offset >= size) {
+		return;
+	}
+
+	// Whole pages inside the range only, the ones at its ends may still be in use
+	const size_t page = size_t(sysconf(_SC_PAGESIZE));
+	const size_t begin = (offset + page - 1) / page * page;
+	const size_t end = (bytes < size - offset ? offset + bytes : size) / page * page;
+	if (begin >= end) {
+		return;
+	}
+
+	if (writable) {
+		msync(data + begin, end - begin, MS_ASYNC);
+	}
+	// Shared file pages keep their content in the page cache, they are only unmapped from the process
+	madvise(data + begin, end - begin, MADV_DONTNEED);
+}
+#endif
@@ -1,250 +1,724 @@
 #include "mesh.h"
 
-// For each edge we will keep an adjecent faces indices
-struct AdjFaces {
-	// It is possible there are holes in the geometry
-	// This is when an edge may have only one adjecent face
-	int f1 = -1;
-	int f2 = -1;
-};
+// C std
+#include <cstdio>
+#include <cstdlib>
+
+// C++ std
+#include <algorithm>
+
+#include "incremental_subdivision.h"
+#include "limit_surface.h"
+#include "mesh_export.h"
+#include "mesh_import.h"
+#include "tiled_subdivision.h"
+
+// The new points are written in a single array ordered as
+// [updated old verts (n) | face points (m) | edge points (k)]
+// The step itself is a SubdivisionJob, the point rules live in subdivision_kernels.cpp.
+
+bool Mesh::importMesh(const char *path) {
+	Vec<Vec3> newPs;
+	Vec<Vec4i> newFaces;
+	Polygons polygons;
+	if (!importCage(path, newPs, newFaces, polygons)) {
+		return false;
+	}
+	if (polygons.count()) {
+		subdividePolygons(newPs, newFaces, polygons);
+	}
+	if (newFaces.empty()) {
+		fprintf(stderr, "Mesh::importMesh: %s has no faces\n", path);
+		return false;
+	}
+
+	// Nothing of the old cage survives
+	cancelSubdivision();
+	clearLevelCache();
+	ps = std::move(newPs);
+	faces = std::move(newFaces);
+	cagePs.clear();
+	cageFaces.clear();
+	topology = Topology{};
+	vertOrder.clear();
+	grid.clear();
+	refinement.reset();
+	sharedLevel.reset();
+	stencils = StencilTable{};
+	adaptive = AdaptiveMesh{};
+	evaluator = LimitEvaluator{};
+	dirtyRanges.clear();
+	level = 0;
+	maxLevel = 0;
+	subdivided = true;
+	pointsMoved = false;
+	touch();
+	updateLimit();
+	triangulate();
+	return true;
+}
+
+bool Mesh::exportLevel(const char *path, ExportStats *stats) const {
+	if (!grid.empty()) {
+		// The only copy made, grid levels have no explicit quads
+		Vec<Vec4i> quads;
+		grid.quads(quads);
+		return ::exportLevel(path, exportFormatOf(path), level, points(), quads, triangles(), stats);
+	}
+	return ::exportLevel(path, exportFormatOf(path), level, points(), quads(), triangles(), stats);
+}
+
+void Mesh::subdivide() {
+	cancelSubdivision();
+	if (cachedVersion(level + 1)) {
+		setLevel(level + 1);
+		return;
+	}
+
+	// The current level is lent to the step and given back before it is cached
+	SubdivisionJob step;
+	prepareJob(step, false);
+	step.run();
+	finishJob(step, true);
+}
+
+void Mesh::subdivideAsync() {
+	if (job) {
+		return;
+	}
+	if (cachedVersion(level + 1)) {
+		setLevel(level + 1);
+		return;
+	}
+
+	job.reset(new SubdivisionJob);
+	prepareJob(*job, true);
+	job->start();
+}
+
+bool Mesh::pollSubdivision() {
+	for (int i = int(cancelledJobs.size()) - 1; i >= 0; --i) {
+		if (cancelledJobs[i]->done()) {
+			cancelledJobs.erase(cancelledJobs.begin() + i);
+		}
+	}
+
+	if (!job || !job->done()) {
+		return false;
+	}
+
+	job->wait();
+	finishJob(*job, false);
+	job.reset();
+	return true;
+}
+
+void Mesh::cancelSubdivision() {
+	if (!job) {
+		return;
+	}
+
+	// Not joined here, the job only stops at the end of its current stage
+	job->cancel();
+	cancelledJobs.push_back(std::move(job));
+}
+
+const SubdivisionJob* Mesh::subdivisionJob() const {
+	return job.get();
+}
+
+void Mesh::prepareJob(SubdivisionJob &step, bool snapshot) {
+	if (level == 0) {
+		cagePs = ps;
+		cageFaces = faces;
+	}
+
+	step.adaptive = adaptiveMode;
+	step.engine = engine;
+	step.spatialOrder = spatialOrder && engine == SubdivisionEngine::Global;
+	step.gridStorage = gridLevels();
+	step.limitProjection = limitProjection;
+	step.patchRate = patchRate;
+	step.level = level + 1;
+	if (sharesTopology()) {
+		if (!refinement || refinement->vertCount != int(cagePs.size()) || refinement->level(0).faces != cageFaces) {
+			refinement = sharedTopology(cageFaces, cagePs.size());
+		}
+		step.refinement = refinement;
+	}
+	if (step.fromCage()) {
+		step.cagePs = cagePs;
+		step.cageFaces = cageFaces;
+	} else if (snapshot && step.refinement) {
+		step.ps = ps; // the connectivity comes from the refinement
+	} else if (snapshot) {
+		step.ps = ps;
+		step.faces = faces;
+		step.topology = topology;
+	} else {
+		step.ps = std::move(ps);
+		step.faces = std::move(faces);
+		step.topology = std::move(topology);
+	}
+
+	// Outputs the step overwrites entirely go into the spare buffers
+	if (!adaptiveMode) {
+		step.scratch = std::move(scratch);
+		step.newPs = std::move(spare.ps);
+		// A step with a refinement computes no connectivity
+		if (!step.gridStorage && !step.refinement) {
+			step.newFaces = std::move(spare.faces);
+			step.triFaces = std::move(spare.triFaces);
+		}
+		if (engine == SubdivisionEngine::Global && !step.refinement) {
+			step.newTopology = std::move(spare.topology);
+		}
+		if (limitProjection) {
+			step.limitPs = std::move(spare.limitPs);
+			step.normals = std::move(spare.normals);
+		}
+	}
+}
+
+void Mesh::finishJob(SubdivisionJob &step, bool lent) {
+	if (lent && !step.fromCage()) {
+		ps = std::move(step.ps);
+		faces = std::move(step.faces);
+		topology = std::move(step.topology); // built by the step if it was missing
+	}
+
+	storeLevel();
+	ps = std::move(step.newPs);
+	faces = std::move(step.newFaces);
+	triFaces = std::move(step.triFaces);
+	topology = std::move(step.newTopology);
+	limitPs = std::move(step.limitPs);
+	normals = std::move(step.normals);
+	vertOrder = std::move(step.vertOrder);
+	grid = std::move(step.grid);
+	sharedLevel = std::move(step.sharedLevel);
+	if (step.adaptive) {
+		adaptive = std::move(step.adaptiveMesh);
+	}
+	scratch = std::move(step.scratch);
+	PROFILE(profile.record(step.profile));
+
+	level = step.level;
+	maxLevel = Max(maxLevel, level);
+	subdivided = true;
+	pointsMoved = false;
+	touch();
+	evictLevels();
+}
+
+int Mesh::cageVertCount() const {
+	return level == 0 ? ps.size() : cagePs.size();
+}
+
+Vec3 Mesh::cageVertex(int i) const {
+	return level == 0 ? ps[i] : cagePs[i];
+}
+
+const Vec<Vec3>& Mesh::cagePoints() const {
+	return level == 0 ? ps : cagePs;
+}
+
+const Vec<Vec4i>& Mesh::cageQuads() const {
+	return level == 0 ? faces : cageFaces;
+}
 
-using EdgeAdjFacesMap = HashMap<int, AdjFaces>;
-using VertAdjFacesMap = HashMap<int, Set<int>>; // for each vert -> set of face indecies
-using VertAdjEdgesMap = VertAdjFacesMap; // for each vert -> set of edge indices
-using FaceAdjEdgesMap = HashMap<int, int[4]>; // for each face -> 4 edge indices
+void Mesh::setCageVertex(int i, const Vec3 &p) {
+	cancelSubdivision();
+	pointsMoved = true;
+	evaluator = LimitEvaluator{};
+	if (editLevels(i, p)) {
+		return;
+	}
+
+	clearLevelCache(); // the other levels would need the same edit
+	touch();
+	dirtyRanges = { { 0, int(ps.size()) } };
+	if (int(cagePs.size()) > i) {
+		cagePs[i] = p;
+	}
+	if (level == 0) {
+		ps[i] = p;
+		updateLimit();
+		return;
+	}
+
+	if (adaptiveMode) {
+		buildAdaptive();
+		return;
+	}
 
-struct Vec2iHasher {
-	std::size_t operator()(const Vec2i &v) const {
-		std::size_t h = std::size_t(v.x) << 32 + std::size_t(v.y);
-		return std::hash<std::size_t>()(h);
+	// The stencils follow the numbering of the global engine without reordering
+	if (!vertOrder.empty()) {
+		rebuildUniform();
+		return;
 	}
+	if (!grid.empty()) {
+		tiledPoints(cagePs, cageFaces, level, ps);
+	} else if (engine == SubdivisionEngine::Tiled) {
+		tiledSubdivide(cagePs, cageFaces, level, ps, faces);
+	} else {
+		if (!stencils.matches(cagePs.size(), level)) {
+			stencils.build(cageFaces, cagePs.size(), level);
+		}
+		stencils.evaluate(cagePs, ps);
+	}
+	updateLimit();
+}
+
+// Fields of level l, wherever it is. The connectivity may be that of the refinement.
+struct LevelRef {
+	Vec<Vec3> *ps;
+	const Vec<Vec4i> *faces;
+	const Topology *topology;
+	Vec<Vec3> *limitPs;
+	Vec<Vec3> *normals;
+	Vec<int> *vertOrder;
 };
 
-void findEdgesAndFacePoints(
-	const Mesh &mesh,
-	Vec<Vec3> &facePoints,
-	Vec<Vec2i> &edges,
-	VertAdjEdgesMap &vertAdjEdges,
-	VertAdjFacesMap &vertAdjFaces,
-	FaceAdjEdgesMap &faceAdjEdges,
-	EdgeAdjFacesMap &edgeAdjFaces) {
-	const auto &ps = mesh.ps;
-	const auto &faces = mesh.faces;
-
-	using Edge = Vec2i;
-	using EdgeMap = HashMapCustom<Edge, int, Vec2iHasher>;
-	EdgeMap edgesMap;
-
-	for (int i = 0; i < faces.size(); ++i) {
-		int adjEdgeIdx = 0;
-		const auto &face = faces[i];
-
-		Vec3 facePoint{ 0.f, 0.f, 0.f };
-		for (int j = 0; j < Mesh::QUAD_FACE_VERTS; ++j) {
-			facePoint += ps[face[j]];
-			
-			// Add face to the adjacency set of its verts
-			vertAdjFaces[face[j]].insert(i);
-
-			// Find new edges and update maps
-			Edge edge;
-			edge.x = face[j];
-			edge.y = face[(j + 1) % Mesh::QUAD_FACE_VERTS];
-
-			Edge reverseEdge{ edge.y, edge.x };
-
-			EdgeMap::const_iterator it = edgesMap.find(edge);
-			EdgeMap::const_iterator rit = edgesMap.find(reverseEdge);
-
-			int eIdx = -1;
-			if (it == edgesMap.end() && rit == edgesMap.end()) {
-				edges.push_back(edge);
-				eIdx = edges.size() - 1;
-				edgesMap[edge] = eIdx;
-			} else {
-				eIdx = it == edgesMap.end() ? rit->second : it->second;
-			}
+bool Mesh::editLevels(int i, const Vec3 &p) {
+	// Adaptive and tiled levels are not numbered from the level below
+	if (adaptiveMode || engine != SubdivisionEngine::Global) {
+		return false;
+	}
 
-			vertAdjEdges[edge.x].insert(eIdx);
-			vertAdjEdges[edge.y].insert(eIdx);
-			faceAdjEdges[i][adjEdgeIdx++] = eIdx;
+	// Levels 0 to top are all there, the current one included
+	int top = -1;
+	while (top + 1 == level || cachedVersion(top + 1)) {
+		++top;
+	}
+	if (top < level) {
+		return false;
+	}
 
-			if (edgeAdjFaces[eIdx].f1 == -1) {
-				edgeAdjFaces[eIdx].f1 = i;
-			} else {
-				edgeAdjFaces[eIdx].f2 = i;
+	Vec<int> dirty = { i }, children, ring;
+	LevelRef parent{};
+	for (int l = 0; l <= top; ++l) {
+		CachedLevel *c = l == level ? nullptr : &levelCache[l];
+		const TopologyLevel *shared = c ? c->sharedLevel.get() : sharedLevel.get();
+		Topology &ownTopology = c ? c->topology : topology;
+		const Vec<Vec4i> &levelFaces = shared ? shared->faces : c ? c->faces : faces;
+		const LevelRef d = c ? LevelRef{ &c->ps, &levelFaces, shared ? &shared->topology : &ownTopology, &c->limitPs, &c->normals, &c->vertOrder } :
+			LevelRef{ &ps, &levelFaces, shared ? &shared->topology : &ownTopology, &limitPs, &normals, &vertOrder };
+		if (l == 0) {
+			(*d.ps)[i] = p;
+		} else {
+			dirtyChildren(*parent.faces, *parent.topology, dirty, children);
+			refineVertices(*parent.faces, *parent.topology, *parent.ps, children, *d.vertOrder, *d.ps);
+			if (!d.vertOrder->empty()) {
+				for (int &v : children) {
+					v = (*d.vertOrder)[v];
+				}
+				std::sort(children.begin(), children.end());
 			}
+			dirty.swap(children);
 		}
-		facePoints[i] = facePoint / float(Mesh::QUAD_FACE_VERTS);
-	}
-}
-
-void findEdgePoints(
-	const Mesh &mesh,
-	const Vec<Vec3> &facePoints,
-	const Vec<Vec2i> &edges,
-	Vec<Vec2i> &newEdges,
-	Vec<Vec3> &edgePoints,
-	VertAdjEdgesMap &vertAdjEdges,
-	EdgeAdjFacesMap &edgeAdjFaces) {
-	const auto &ps = mesh.ps;
-	const auto &faces = mesh.faces;
-	
-	const int n = ps.size();
-	const int m = faces.size();
-	const int k = edges.size();
-	int neIdx = 0;
-
-	for (int i = 0; i < edges.size(); ++i) {
-		const auto edge = edges[i];
-
-		// for each vertex of the edge, add the edge index to the adjecency set of that vertex
-		vertAdjEdges[edge[0]].insert(i);
-		vertAdjEdges[edge[1]].insert(i);
-
-		// Find the middle point of the edge and average it with the average of the neigbouring faces' face points.
-		const Vec3 edgeMiddle = (ps[edge[0]] + ps[edge[1]]) / 2.f;
-		const int f1 = edgeAdjFaces[i].f1;
-		const int f2 = edgeAdjFaces[i].f2;
-
-		// These new edge points will be added to the ps array, after we add the new face points.
-		// So the old ps array has size n, after we add the face points its size becomes n + m. Thus:
-		const int edgeMiddleIdx = n + m + i;
-		// Connect middle point to vertices of the edge
-		newEdges[neIdx++] = { edgeMiddleIdx, edge[0] };
-		newEdges[neIdx++] = { edgeMiddleIdx, edge[1] };
-
-		// Connect middle point to the neighbouring facepoints
-		if (f1 >= 0) {
-			newEdges[neIdx++] = { edgeMiddleIdx, n + f1 };
+
+		const bool limit = !d.limitPs->empty();
+		if ((limit || l < top) && !shared) {
+			levelTopology(l, levelFaces, d.ps->size(), ownTopology);
 		}
-		if (f2 >= 0) {
-			newEdges[neIdx++] = { edgeMiddleIdx, n + f2 };
+		if (limit) {
+			vertexRing(*d.faces, *d.topology, dirty, ring);
+			limitProjectVertices(*d.faces, *d.topology, *d.ps, ring, *d.limitPs, *d.normals);
 		}
 
-		// If edge is on a border of a hole we use the middle point as an edge point
-		if (f1 == -1 || f2 == -1) {
-			edgePoints[i] = edgeMiddle;
-			continue;
+		if (c) {
+			c->version = ++lastVersion;
+		} else {
+			touch();
+			addDirtyRanges(limit ? ring : dirty, dirtyRanges);
 		}
+		parent = d;
+	}
 
-		const Vec3 facesMiddle = (facePoints[f1] + facePoints[f2]) / 2.f;
-		edgePoints[i] = (edgeMiddle + facesMiddle) / 2.f;
+	// Levels past a gap still come from the old cage
+	for (int l = top + 1; l < int(levelCache.size()); ++l) {
+		recycle(levelCache[l]);
 	}
+	if (int(cagePs.size()) > i) {
+		cagePs[i] = p;
+	}
+	return true;
 }
 
-void updatePoints(
-	const VertAdjFacesMap &vertAdjFaces,
-	const VertAdjEdgesMap &vertAdjEdges,
-	const EdgeAdjFacesMap &edgeAdjFaces,
-	const Vec<Vec3> &facePoints,
-	const Vec<Vec2i> &edges,
-	Vec<Vec3> &ps) {
+void Mesh::setAdaptive(bool on) {
+	if (adaptiveMode == on) {
+		return;
+	}
+	cancelSubdivision();
+
+	adaptiveMode = on;
+	clearLevelCache();
+	if (level == 0) {
+		return;
+	}
 
-	// TODO: check if vertex is on a border of a hole
-	for (int i = 0; i < ps.size(); ++i) {
-		const Set<int>& adjFaces = vertAdjFaces.find(i)->second;
-		const Set<int>& adjEdges = vertAdjEdges.find(i)->second;
+	if (adaptiveMode) {
+		buildAdaptive();
+		return;
+	}
+	rebuildUniform();
+}
 
-		if (adjEdges.size() == adjFaces.size()) {
-			Vec3 avgFacesPoint{ 0.f, 0.f, 0.f };
-			for (const auto& v : adjFaces) {
-				avgFacesPoint += facePoints[v];
-			}
-			avgFacesPoint /= float(adjFaces.size());
+void Mesh::setEngine(SubdivisionEngine e) {
+	if (engine == e) {
+		return;
+	}
+	cancelSubdivision();
 
-			Vec3 avgEdgesPoint{ 0.f, 0.f, 0.f };
-			for (const auto& v : adjEdges) {
-				avgEdgesPoint += (ps[edges[v][0]] + ps[edges[v][1]]) / 2.f;
-			}
-			avgEdgesPoint /= float(adjEdges.size());
-
-			const int n = adjEdges.size();
-			ps[i] = (ps[i] * float(n - 3) + avgFacesPoint + 2.f * avgEdgesPoint) / float(n);
-		} else { // vertex is on the border of a hole
-			int n = 0;
-			Vec3 newPoint = ps[i];
-			for (const auto& v : adjEdges) {
-				const AdjFaces& af = edgeAdjFaces.find(v)->second;
-				if (af.f1 >= 0 && af.f2 >= 0) {
-					continue;
-				}
-				newPoint += (ps[edges[v][0]] + ps[edges[v][1]]) / 2.f;
-				++n;
+	engine = e;
+	clearLevelCache();
+	if (level == 0 || adaptiveMode) {
+		return;
+	}
+	rebuildUniform();
+}
+
+void Mesh::setSpatialOrder(bool on) {
+	if (spatialOrder == on) {
+		return;
+	}
+	cancelSubdivision();
+
+	spatialOrder = on;
+	clearLevelCache();
+	if (level == 0 || adaptiveMode || engine != SubdivisionEngine::Global) {
+		return;
+	}
+	rebuildUniform();
+}
+
+void Mesh::setGridStorage(bool on) {
+	if (gridStorage == on) {
+		return;
+	}
+	cancelSubdivision();
+
+	gridStorage = on;
+	clearLevelCache();
+	if (level == 0 || adaptiveMode || engine != SubdivisionEngine::Tiled) {
+		return;
+	}
+	rebuildUniform();
+}
+
+// Copies of the connectivity a level refers to in the refinement
+void ownConnectivity(std::shared_ptr<const TopologyLevel> &shared, Vec<Vec4i> &faces, Vec<Vec3i> &triFaces, Topology &topology) {
+	if (!shared) {
+		return;
+	}
+	faces = shared->faces;
+	triFaces = shared->triFaces;
+	topology = shared->topology;
+	shared.reset();
+}
+
+void Mesh::setShareTopology(bool on) {
+	cancelSubdivision();
+	if (!on && sharesTopology()) {
+		// The levels get their own connectivity before the refinement goes
+		ownConnectivity(sharedLevel, faces, triFaces, topology);
+		levelTopology(level, faces, ps.size(), topology);
+		for (int l = 0; l < int(levelCache.size()); ++l) {
+			CachedLevel &c = levelCache[l];
+			if (c.version) {
+				ownConnectivity(c.sharedLevel, c.faces, c.triFaces, c.topology);
+				levelTopology(l, c.faces, c.ps.size(), c.topology);
 			}
-			ps[i] = newPoint / float(n + 1);
 		}
 	}
+	shareTopology = on;
+	if (!on) {
+		refinement.reset();
+	}
+}
+
+bool Mesh::sharesTopology() const {
+	return shareTopology && !adaptiveMode && engine == SubdivisionEngine::Global && !spatialOrder;
+}
+
+// Built from the faces, the topology of a level that came from the refinement would number the
+// edges differently from the refinement of the level below, so it is copied from there instead
+void Mesh::levelTopology(int l, const Vec<Vec4i> &levelFaces, int vertCount, Topology &t) {
+	if (t.matches(levelFaces)) {
+		return;
+	}
+	if (refinement && sharesTopology() && refinement->level(l).faces.size() == levelFaces.size()) {
+		t = refinement->level(l).topology;
+		return;
+	}
+	buildTopology(levelFaces, vertCount, t);
+}
+
+void Mesh::rebuildUniform() {
+	// The global engine goes level by level, the tiled one straight to the current level
+	const int lvl = level;
+	restoreCage();
+	if (engine == SubdivisionEngine::Tiled) {
+		SubdivisionJob step;
+		prepareJob(step, false);
+		step.level = lvl;
+		step.run();
+		finishJob(step, true);
+		return;
+	}
+	while (level < lvl) {
+		subdivide();
+	}
+}
+
+void Mesh::setPatchRate(int rate) {
+	cancelSubdivision();
+	patchRate = Max(1, rate);
+	if (adaptiveMode) {
+		clearLevelCache();
+	}
+	if (adaptiveMode && level > 0) {
+		tessellateAdaptive();
+	}
 }
 
-void generateNewFaces(
-	const Vec<Vec4i> &faces,
-	const FaceAdjEdgesMap &faceAdjEdges,
-	int vertCount,
-	Vec<Vec4i> &newFaces) {
-	const int n = vertCount;
-	const int m = faces.size();
+void Mesh::setLimitProjection(bool on) {
+	cancelSubdivision();
+	limitProjection = on;
+	updateLimit();
+	touch();
+	subdivided = true; // the normal buffer comes or goes
+}
 
-	int nfIdx = 0;
-	for (int i = 0; i < faces.size(); ++i) {
-		const auto face = faces[i];
-		const int a = face[0];
-		const int b = face[1];
-		const int c = face[2];
-		const int d = face[3];
+void Mesh::updateLimit() {
+	if (adaptiveMode && level > 0) {
+		return;
+	}
+
+	if (!limitProjection || !grid.empty()) {
+		limitPs.clear();
+		normals.clear();
+		return;
+	}
 
-		const auto &adjEdges = faceAdjEdges.find(i)->second;
-		// indices of the edge points in the updated ps array
-		const int edgeAB = n + m + adjEdges[0];
-		const int edgeBC = n + m + adjEdges[1];
-		const int edgeCD = n + m + adjEdges[2];
-		const int edgeDA = n + m + adjEdges[3];
+	if (sharedLevel) {
+		limitProject(sharedLevel->faces, sharedLevel->topology, ps, limitPs, normals);
+		return;
+	}
+	levelTopology(level, faces, ps.size(), topology);
+	limitProject(faces, topology, ps, limitPs, normals);
+}
 
-		// keep the order of the points in the new faces, since we'll need it for the triangulation
-		const int fp = n + i;
-		newFaces[nfIdx++] = { a, edgeAB, fp, edgeDA };
-		newFaces[nfIdx++] = { edgeAB, b, edgeBC, fp };
-		newFaces[nfIdx++] = { fp, edgeBC, c, edgeCD };
-		newFaces[nfIdx++] = { edgeDA, fp, edgeCD, d };
+const LimitEvaluator& Mesh::limitEvaluator() {
+	if (!evaluator.built()) {
+		evaluator.build(cagePoints(), cageQuads());
 	}
+	return evaluator;
 }
 
-void Mesh::subdivide() {
-	EdgeAdjFacesMap edgeAdjFaces;
-	VertAdjFacesMap vertAdjFaces;
-	VertAdjEdgesMap vertAdjEdges;
-	FaceAdjEdgesMap faceAdjEdges;
-
-	Vec<Vec2i> edges;
-	Vec<Vec3> facePoints(faces.size());
-	findEdgesAndFacePoints(*this, facePoints, edges, vertAdjEdges, vertAdjFaces, faceAdjEdges, edgeAdjFaces);
-
-	Vec<Vec2i> newEdges(2 * edges.size() + 4 * faces.size());
-	Vec<Vec3> edgePoints(edges.size());
-	findEdgePoints(*this, facePoints, edges, newEdges, edgePoints, vertAdjEdges, edgeAdjFaces);
-	
-	updatePoints(vertAdjFaces, vertAdjEdges, edgeAdjFaces, facePoints, edges, ps);
-
-	const int n = ps.size(); // save old vertex count for later use
-	ps.insert(ps.end(), facePoints.cbegin(), facePoints.cend());
-	ps.insert(ps.end(), edgePoints.cbegin(), edgePoints.cend());
-
-	Vec<Vec4i> newFaces(faces.size() * QUAD_FACE_VERTS);
-	generateNewFaces(faces, faceAdjEdges, n, newFaces);
-	
-	edges = newEdges;
-	faces = newFaces;
+void Mesh::buildAdaptive() {
+	adaptive.build(cagePs, cageFaces, level);
+	tessellateAdaptive();
+}
+
+void Mesh::tessellateAdaptive() {
+	adaptive.tessellate(patchRate, ps, normals, faces);
+	sharedLevel.reset();
+	limitPs.clear();
+	topology = Topology{}; // faces are no longer a subdivision level
+	vertOrder.clear();
+	grid.clear();
 	subdivided = true;
+	pointsMoved = false;
+	touch();
+	triangulate();
+}
 
+/*
+============================================================================================
+ Level cache
+============================================================================================
+*/
+size_t CachedLevel::bytes() const {
+	return bytesOf(ps) + bytesOf(triFaces) + bytesOf(faces) + topology.bytes() + bytesOf(limitPs) + bytesOf(normals) + bytesOf(vertOrder) + grid.bytes();
+}
+
+void Mesh::setLevel(int l) {
+	if (l < 0 || l == level) {
+		return;
+	}
+	cancelSubdivision();
+
+	if (level == 0) {
+		cagePs = ps;
+		cageFaces = faces;
+	}
+
+	storeLevel();
+	if (!restoreLevel(l)) {
+		// Refine from the nearest level below that is still there, the cage at worst
+		int from = l - 1;
+		while (from > 0 && !cachedVersion(from)) {
+			--from;
+		}
+		if (!restoreLevel(from)) {
+			restoreCage();
+		}
+		while (level < l) {
+			subdivide();
+		}
+	}
+	evictLevels();
+}
+
+void Mesh::setCacheBudget(size_t bytes) {
+	cacheBudget = bytes;
+	evictLevels();
+}
+
+unsigned int Mesh::cachedVersion(int l) const {
+	return l >= 0 && l < int(levelCache.size()) ? levelCache[l].version : 0;
+}
+
+size_t Mesh::cacheBytes() const {
+	size_t bytes = 0;
+	for (const CachedLevel &c : levelCache) {
+		bytes += c.bytes();
+	}
+	return bytes;
+}
+
+size_t Mesh::levelBytes() const {
+	return bytesOf(ps) + bytesOf(triFaces) + bytesOf(faces) + topology.bytes() + bytesOf(limitPs) + bytesOf(normals) + bytesOf(vertOrder) + grid.bytes();
+}
+
+int Mesh::cachedLevelCount() const {
+	int count = 0;
+	for (const CachedLevel &c : levelCache) {
+		count += c.version != 0;
+	}
+	return count;
+}
+
+void Mesh::touch() {
+	version = ++lastVersion;
+}
+
+void Mesh::restoreCage() {
+	ps = cagePs;
+	faces = cageFaces;
+	topology = Topology{};
+	sharedLevel.reset();
+	vertOrder.clear();
+	grid.clear();
+	level = 0;
+	subdivided = true;
+	pointsMoved = false;
+	touch();
+	updateLimit();
 	triangulate();
 }
 
+void Mesh::storeLevel() {
+	if (ps.empty()) {
+		return;
+	}
+
+	if (int(levelCache.size()) <= level) {
+		levelCache.resize(level + 1);
+	}
+	CachedLevel &c = levelCache[level];
+	c.version = version;
+	c.ps = std::move(ps);
+	c.triFaces = std::move(triFaces);
+	c.faces = std::move(faces);
+	c.topology = std::move(topology);
+	c.limitPs = std::move(limitPs);
+	c.normals = std::move(normals);
+	c.vertOrder = std::move(vertOrder);
+	c.grid = std::move(grid);
+	c.sharedLevel = std::move(sharedLevel);
+
+	ps.clear();
+	triFaces.clear();
+	faces.clear();
+	topology = Topology{};
+	limitPs.clear();
+	normals.clear();
+	vertOrder.clear();
+	grid.clear();
+}
+
+bool Mesh::restoreLevel(int l) {
+	if (!cachedVersion(l)) {
+		return false;
+	}
+
+	CachedLevel &c = levelCache[l];
+	version = c.version;
+	ps = std::move(c.ps);
+	triFaces = std::move(c.triFaces);
+	faces = std::move(c.faces);
+	topology = std::move(c.topology);
+	limitPs = std::move(c.limitPs);
+	normals = std::move(c.normals);
+	vertOrder = std::move(c.vertOrder);
+	grid = std::move(c.grid);
+	sharedLevel = std::move(c.sharedLevel);
+	c = CachedLevel{};
+
+	level = l;
+	subdivided = true;
+	pointsMoved = false;
+
+	// Limit projection was switched while the level was away
+	if (limitPs.empty() == limitProjection && !(adaptiveMode && level > 0) && grid.empty()) {
+		updateLimit();
+		touch();
+	}
+	return true;
+}
+
+// Levels farthest from the current one go first, the finer one on a tie
+void Mesh::evictLevels() {
+	size_t bytes = cacheBytes();
+	while (bytes > cacheBudget) {
+		int victim = -1;
+		for (int l = 0; l < int(levelCache.size()); ++l) {
+			if (levelCache[l].version && (victim < 0 || abs(l - level) >= abs(victim - level))) {
+				victim = l;
+			}
+		}
+		if (victim < 0) {
+			break;
+		}
+		bytes -= levelCache[victim].bytes();
+		recycle(levelCache[victim]);
+	}
+}
+
+void Mesh::clearLevelCache() {
+	for (CachedLevel &c : levelCache) {
+		recycle(c);
+	}
+	levelCache.clear();
+}
+
+void Mesh::recycle(CachedLevel &c) {
+	if (c.ps.capacity() > spare.ps.capacity()) {
+		spare = std::move(c);
+		spare.version = 0;
+	}
+	c = CachedLevel{};
+}
+
 Vec<Vec3>& Mesh::points() {
-	return ps;
+	return limitPs.empty() ? ps : limitPs;
 }
 
 const Vec<Vec3>& Mesh::points() const {
-	return ps;
+	return limitPs.empty() ? ps : limitPs;
 }
 
 void Mesh::triangulate() {
@@ -252,13 +726,7 @@ void Mesh::triangulate() {
 		return;
 	}
 
-	triFaces.clear();
-	triFaces.resize(faces.size() * 2);
-	for (int i = 0; i < faces.size(); ++i) {
-		auto f = faces[i];
-		triFaces[2 * i + 0] = { f[0], f[1], f[2] };
-		triFaces[2 * i + 1] = { f[0], f[2], f[3] };
-	}
+	::triangulate(faces, triFaces);
 }
 
 /* 
@@ -304,6 +772,7 @@ bool deleteDefaultCube(Mesh *&cube) {
 		return false;
 	}
 
+	cube->~Mesh();
 	free(data);
 	cube = nullptr;
 	return true;
@@ -0,0 +1,310 @@
+#include "mesh_export.h"
+
+// C std
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+// C++ std
+#include <chrono>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+const char NATIVE_MAGIC[8] = { 'C', 'C', 'M', 'E', 'S', 'H', '0', '1' };
+
+// Mapped levels are written and released in slices of this size
+const size_t EXPORT_SLICE = size_t(16) << 20;
+// PLY face records are assembled in a buffer of about this size
+const size_t FACE_BUFFER = size_t(4) << 20;
+
+ExportFormat exportFormatOf(const char *path) {
+	const char *dot = strrchr(path, '.');
+	String extension = dot ? dot + 1 : "";
+	for (char &c : extension) {
+		c = char(tolower((unsigned char)c));
+	}
+	return extension == "ply" ? ExportFormat::Ply : ExportFormat::Native;
+}
+
+/*
+============================================================================================
+ Output file
+============================================================================================
+*/
+struct Block {
+	const void *data;
+	size_t bytes;
+};
+
+// Unbuffered output, the blocks go from memory to the OS as they are
+struct ExportFile {
+	const char *path = nullptr;
+	size_t bytes = 0;
+	std::chrono::high_resolution_clock::time_point start;
+#ifdef _WIN32
+	HANDLE handle = INVALID_HANDLE_VALUE;
+#else
+	int fd = -1;
+#endif
+
+public:
+	~ExportFile() { close(); }
+	bool open(const char *filePath);
+	bool write(const Block *blocks, int count); // In one call where the OS has one
+	bool write(const void *data, size_t size) { const Block block = { data, size }; return write(&block, 1); }
+	bool finish(ExportStats *stats); // On disk and closed
+	void close();
+};
+
+#ifdef _WIN32
+bool ExportFile::open(const char *filePath) {
+	path = filePath;
+	start = std::chrono::high_resolution_clock::now();
+	handle = CreateFileA(path, GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (handle == INVALID_HANDLE_VALUE) {
+		fprintf(stderr, "ExportFile: cannot create %s\n", path);
+		return false;
+	}
+	return true;
+}
+
+bool ExportFile::write(const Block *blocks, int count) {
+	for (int b = 0; b < count; ++b) {
+		const char *data = (const char*)blocks[b].data;
+		for (size_t done = 0; done < blocks[b].bytes;) {
+			// WriteFile takes a 32 bit size
+			const DWORD size = DWORD(Min(blocks[b].bytes - done, size_t(1) << 30));
+			DWORD written = 0;
+			if (!WriteFile(handle, data + done, size, &written, nullptr) || written == 0) {
+				fprintf(stderr, "ExportFile: cannot write %s\n", path);
+				return false;
+			}
+			done += written;
+			bytes += written;
+		}
+	}
+	return true;
+}
+
+bool ExportFile::finish(ExportStats *stats) {
+	const auto synced = std::chrono::high_resolution_clock::now();
+	const bool ok = FlushFileBuffers(handle) != 0;
+	close();
+	if (stats) {
+		const auto end = std::chrono::high_resolution_clock::now();
+		stats->bytes = bytes;
+		stats->ms = std::chrono::duration<double, std::milli>(end - start).count();
+		stats->syncMs = std::chrono::duration<double, std::milli>(end - synced).count();
+	}
+	if (!ok) {
+		fprintf(stderr, "ExportFile: cannot flush %s\n", path);
+	}
+	return ok;
+}
+
+void ExportFile::close() {
+	if (handle != INVALID_HANDLE_VALUE) {
+		CloseHandle(handle);
+	}
+	handle = INVALID_HANDLE_VALUE;
+}
+#else
+bool ExportFile::open(const char *filePath) {
+	path = filePath;
+	start = std::chrono::high_resolution_clock::now();
+	fd = ::open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		fprintf(stderr, "ExportFile: cannot create %s\n", path);
+		return false;
+	}
+	return true;
+}
+
+bool ExportFile::write(const Block *blocks, int count) {
+	static const int MAX_BLOCKS = 8;
+	iovec vectors[MAX_BLOCKS];
+	int first = 0;
+	while (first < count) {
+		const int n = Min(count - first, MAX_BLOCKS);
+		for (int b = 0; b < n; ++b) {
+			vectors[b].iov_base = (void*)blocks[first + b].data;
+			vectors[b].iov_len = blocks[first + b].bytes;
+		}
+
+		// A call may write less than asked, e.g. Linux stops at about 2 GB
+		int done = 0;
+		for (;;) {
+			while (done < n && vectors[done].iov_len == 0) {
+				++done;
+			}
+			if (done == n) {
+				break;
+			}
+			const ssize_t written = writev(fd, vectors + done, n - done);
+			if (written < 0 && errno == EINTR) {
+				continue;
+			}
+			if (written <= 0) {
+				fprintf(stderr, "ExportFile: cannot write %s\n", path);
+				return false;
+			}
+			bytes += size_t(written);
+			for (size_t left = size_t(written); left > 0;) {
+				const size_t step = Min(left, vectors[done].iov_len);
+				vectors[done].iov_base = (char*)vectors[done].iov_base + step;
+				vectors[done].iov_len -= step;
+				left -= step;
+				if (vectors[done].iov_len == 0) {
+					++done;
+				}
+			}
+		}
+		first += n;
+	}
+	return true;
+}
+
+bool ExportFile::finish(ExportStats *stats) {
+	const auto synced = std::chrono::high_resolution_clock::now();
+	const bool ok = fsync(fd) == 0;
+	close();
+	if (stats) {
+		const auto end = std::chrono::high_resolution_clock::now();
+		stats->bytes = bytes;
+		stats->ms = std::chrono::duration<double, std::milli>(end - start).count();
+		stats->syncMs = std::chrono::duration<double, std::milli>(end - synced).count();
+	}
+	if (!ok) {
+		fprintf(stderr, "ExportFile: cannot flush %s\n", path);
+	}
+	return ok;
+}
+
+void ExportFile::close() {
+	if (fd >= 0) {
+		::close(fd);
+	}
+	fd = -1;
+}
+#endif
+
+/*
+============================================================================================
+ Levels
+============================================================================================
+*/
+// Bytes as they are in memory. Mapped ones in slices, each released once written.
+bool writeRaw(ExportFile &out, const void *data, size_t bytes, MappedFile *mapped) {
+	if (!mapped) {
+		return out.write(data, bytes);
+	}
+	const char *p = (const char*)data;
+	for (size_t done = 0; done < bytes; done += EXPORT_SLICE) {
+		const size_t size = Min(EXPORT_SLICE, bytes - done);
+		if (!out.write(p + done, size)) {
+			return false;
+		}
+		mapped->release(p + done - mapped->data, size);
+	}
+	return true;
+}
+
+// PLY face records: the count byte then the indices
+bool writePlyFaces(ExportFile &out, const int *faces, long long faceCount, int faceVerts, MappedFile *mapped) {
+	const size_t recordSize = 1 + sizeof(int) * faceVerts;
+	const long long perBuffer = (long long)(FACE_BUFFER / recordSize);
+	Vec<char> buffer(size_t(Min(perBuffer, faceCount)) * recordSize);
+	for (long long done = 0; done < faceCount; done += perBuffer) {
+		const long long count = Min(perBuffer, faceCount - done);
+		const int *face = faces + done * faceVerts;
+		char *p = buffer.data();
+		for (long long f = 0; f < count; ++f, face += faceVerts, p += recordSize) {
+			p[0] = char(faceVerts);
+			memcpy(p + 1, face, sizeof(int) * faceVerts);
+		}
+		if (!out.write(buffer.data(), size_t(count) * recordSize)) {
+			return false;
+		}
+		if (mapped) {
+			mapped->release((const char*)(faces + done * faceVerts) - mapped->data, sizeof(int) * faceVerts * size_t(count));
+		}
+	}
+	return true;
+}
+
+bool writeLevel(const char *path, ExportFormat format, int level, const Vec3 *ps, long long vertCount,
+	const int *faces, long long faceCount, int faceVerts, MappedFile *mapped, ExportStats *stats) {
+	ExportFile out;
+	if (!out.open(path)) {
+		return false;
+	}
+
+	const size_t pointBytes = sizeof(Vec3) * size_t(vertCount);
+	const size_t faceBytes = sizeof(int) * faceVerts * size_t(faceCount);
+	bool ok = true;
+	if (format == ExportFormat::Native) {
+		NativeHeader header;
+		memcpy(header.magic, NATIVE_MAGIC, sizeof(NATIVE_MAGIC));
+		header.level = level;
+		header.faceVerts = faceVerts;
+		header.vertCount = vertCount;
+		header.faceCount = faceCount;
+		if (mapped) {
+			ok = out.write(&header, sizeof(header)) && writeRaw(out, ps, pointBytes, mapped) && writeRaw(out, faces, faceBytes, mapped);
+		} else {
+			const Block blocks[] = { { &header, sizeof(header) }, { ps, pointBytes }, { faces, faceBytes } };
+			ok = out.write(blocks, 3);
+		}
+	} else {
+		// A vertex record is a Vec3 as it is in memory
+		char header[512];
+		const int headerSize = snprintf(header, sizeof(header),
+			"ply\n"
+			"format binary_little_endian 1.0\n"
+			"comment Catmull-Clark level %d\n"
+			"element vertex %lld\n"
+			"property float x\n"
+			"property float y\n"
+			"property float z\n"
+			"element face %lld\n"
+			"property list uchar int vertex_indices\n"
+			"end_header\n", level, vertCount, faceCount);
+		if (mapped) {
+			ok = out.write(header, size_t(headerSize)) && writeRaw(out, ps, pointBytes, mapped);
+		} else {
+			const Block blocks[] = { { header, size_t(headerSize) }, { ps, pointBytes } };
+			ok = out.write(blocks, 2);
+		}
+		ok = ok && writePlyFaces(out, faces, faceCount, faceVerts, mapped);
+	}
+
+	ok = ok && out.finish(stats);
+	if (!ok) {
+		fprintf(stderr, "exportLevel: %s is incomplete\n", path);
+	}
+	return ok;
+}
+
+bool exportLevel(const char *path, ExportFormat format, int level, const Vec<Vec3> &ps, const Vec<Vec4i> &quads,
+	const Vec<Vec3i> &tris, ExportStats *stats) {
+	if (!quads.empty() || tris.empty()) {
+		return writeLevel(path, format, level, ps.data(), (long long)ps.size(), (const int*)quads.data(),
+			(long long)quads.size(), 4, nullptr, stats);
+	}
+	return writeLevel(path, format, level, ps.data(), (long long)ps.size(), (const int*)tris.data(),
+		(long long)tris.size(), 3, nullptr, stats);
+}
+
+bool exportMapped(const char *path, ExportFormat format, int level, MappedFile &file, const Vec3 *ps, long long vertCount,
+	const Vec4i *quads, long long quadCount, ExportStats *stats) {
+	return writeLevel(path, format, level, ps, vertCount, (const int*)quads, quadCount, 4, &file, stats);
+}
@@ -0,0 +1,846 @@
+#include "mesh_import.h"
+
+// C std
+#include <cctype>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+// C++ std
+#include <atomic>
+
+#include "mapped_file.h"
+#include "parallel.h"
+
+void Polygons::clear() {
+	offsets.clear();
+	verts.clear();
+}
+
+/*
+============================================================================================
+ Numbers
+============================================================================================
+*/
+bool isDigit(char c) {
+	return c >= '0' && c <= '9';
+}
+
+bool isBlank(char c) {
+	return c == ' ' || c == '\t' || c == '\r';
+}
+
+double powerOf10(int e) {
+	static const double EXACT[] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+	return e <= 22 ? EXACT[e] : std::pow(10.0, double(e));
+}
+
+bool parseFloat(const char *&s, const char *end, float &value) {
+	const char *p = s;
+	const bool negative = p < end && *p == '-';
+	if (p < end && (*p == '-' || *p == '+')) {
+		++p;
+	}
+
+	// 19 significant digits fit the mantissa, the ones after only move the exponent.
+	// The double rounds once more on the way to float, far below what a float keeps.
+	uint64_t mantissa = 0;
+	int digits = 0, exponent = 0;
+	bool any = false;
+	for (; p < end && isDigit(*p); ++p, any = true) {
+		if (digits < 19) {
+			mantissa = mantissa * 10 + (*p - '0');
+			digits += mantissa != 0;
+		} else {
+			++exponent;
+		}
+	}
+	if (p < end && *p == '.') {
+		for (++p; p < end && isDigit(*p); ++p, any = true) {
+			if (digits < 19) {
+				mantissa = mantissa * 10 + (*p - '0');
+				digits += mantissa != 0;
+				--exponent;
+			}
+		}
+	}
+	if (!any) {
+		return false;
+	}
+
+	if (p < end && (*p == 'e' || *p == 'E')) {
+		const char *q = p + 1;
+		const bool negativeExponent = q < end && *q == '-';
+		if (q < end && (*q == '-' || *q == '+')) {
+			++q;
+		}
+		if (q < end && isDigit(*q)) {
+			int e = 0;
+			for (; q < end && isDigit(*q); ++q) {
+				e = Min(e * 10 + (*q - '0'), 9999);
+			}
+			exponent += negativeExponent ? -e : e;
+			p = q;
+		}
+	}
+
+	double v = double(mantissa);
+	if (mantissa != 0) {
+		v = exponent < 0 ? v / powerOf10(-exponent) : v * powerOf10(exponent);
+	}
+	value = float(negative ? -v : v);
+	s = p;
+	return true;
+}
+
+bool parseInt(const char *&s, const char *end, int &value) {
+	const char *p = s;
+	const bool negative = p < end && *p == '-';
+	if (p < end && (*p == '-' || *p == '+')) {
+		++p;
+	}
+	if (p == end || !isDigit(*p)) {
+		return false;
+	}
+
+	long long v = 0;
+	for (; p < end && isDigit(*p); ++p) {
+		v = v * 10 + (*p - '0');
+		if (v > INT_MAX) {
+			return false;
+		}
+	}
+	value = int(negative ? -v : v);
+	s = p;
+	return true;
+}
+
+/*
+============================================================================================
+ OBJ
+============================================================================================
+*/
+// Lines [begin, end) of the file. A first pass counts what each chunk holds, the prefix sums
+// of the counts then tell every chunk where it writes in the second pass.
+struct ObjChunk {
+	const char *begin = nullptr;
+	const char *end = nullptr;
+	int lines = 0;
+	int verts = 0;
+	int quads = 0;
+	int polygons = 0;
+	int polygonVerts = 0;
+
+	int firstLine = 0;
+	int firstVert = 0;
+	int firstQuad = 0;
+	int firstPolygon = 0;
+	int firstPolygonVert = 0;
+	int errorLine = -1; // First line of the chunk that could not be read
+};
+
+// Calls fn(index, begin, end) for every line in [begin, end), without the line feed
+template <class Func>
+void forEachLine(const char *begin, const char *end, Func fn) {
+	int index = 0;
+	for (const char *line = begin; line < end; ++index) {
+		const char *eol = (const char*)memchr(line, '\n', end - line);
+		if (!eol) {
+			eol = end;
+		}
+		fn(index, line, eol);
+		line = eol + 1;
+	}
+}
+
+// 'v' or 'f' for a vertex or face line, whose fields then start at line, 0 otherwise
+char objElement(const char *&line, const char *eol) {
+	while (line < eol && isBlank(*line)) {
+		++line;
+	}
+	if (eol - line < 2 || (line[0] != 'v' && line[0] != 'f') || !isBlank(line[1])) {
+		return 0;
+	}
+	line += 2;
+	return line[-2];
+}
+
+// End of the fields of a line, where a trailing # comment starts if there is one
+const char* fieldsEnd(const char *line, const char *eol) {
+	const char *comment = (const char*)memchr(line, '#', eol - line);
+	return comment ? comment : eol;
+}
+
+int fieldCount(const char *line, const char *eol) {
+	int count = 0;
+	for (const char *p = line; p < eol; ++p) {
+		count += !isBlank(*p) && (p == line || isBlank(p[-1]));
+	}
+	return count;
+}
+
+void countObjChunk(ObjChunk &c) {
+	forEachLine(c.begin, c.end, [&](int index, const char *line, const char *eol) {
+		++c.lines;
+		const char element = objElement(line, eol);
+		eol = fieldsEnd(line, eol);
+		if (element == 'v') {
+			++c.verts;
+		} else if (element == 'f') {
+			const int count = fieldCount(line, eol);
+			if (count == 4) {
+				++c.quads;
+			} else if (count >= 3) {
+				++c.polygons;
+				c.polygonVerts += count;
+			} else if (c.errorLine < 0) {
+				c.errorLine = index;
+			}
+		}
+	});
+}
+
+void readObjChunk(ObjChunk &c, int vertCount, Vec<Vec3> &ps, Vec<Vec4i> &quads, Polygons &polygons) {
+	int verts = 0, quadCount = 0, polygonCount = 0, polygonVerts = 0;
+	forEachLine(c.begin, c.end, [&](int index, const char *line, const char *eol) {
+		if (c.errorLine >= 0) {
+			return;
+		}
+		const char element = objElement(line, eol);
+		eol = fieldsEnd(line, eol);
+		if (element == 'v') {
+			Vec3 &p = ps[c.firstVert + verts++];
+			for (int k = 0; k < 3; ++k) {
+				while (line < eol && isBlank(*line)) {
+					++line;
+				}
+				if (!parseFloat(line, eol, p[k])) {
+					c.errorLine = index;
+					return;
+				}
+			}
+		} else if (element == 'f') {
+			// Only the position index of v/vt/vn, relative ones count back from this line. The first four
+			// wait in face until the line tells whether it is a quad.
+			int face[4], count = 0;
+			int *polygon = polygons.verts.data() + c.firstPolygonVert + polygonVerts;
+			for (const char *p = line; p < eol;) {
+				while (p < eol && isBlank(*p)) {
+					++p;
+				}
+				if (p == eol) {
+					break;
+				}
+				int i = 0;
+				if (!parseInt(p, eol, i) || i == 0) {
+					c.errorLine = index;
+					return;
+				}
+				i = i > 0 ? i - 1 : c.firstVert + verts + i;
+				if (i < 0 || i >= vertCount) {
+					c.errorLine = index;
+					return;
+				}
+				if (count == 4) {
+					memcpy(polygon, face, sizeof(face));
+				}
+				(count < 4 ? face : polygon)[count] = i;
+				++count;
+				while (p < eol && !isBlank(*p)) {
+					++p;
+				}
+			}
+			if (count == 4) {
+				quads[c.firstQuad + quadCount++] = { face[0], face[1], face[2], face[3] };
+				return;
+			}
+			if (count == 3) {
+				memcpy(polygon, face, 3 * sizeof(int));
+			}
+			polygons.offsets[c.firstPolygon + polygonCount++] = c.firstPolygonVert + polygonVerts;
+			polygonVerts += count;
+		}
+	});
+}
+
+bool importObj(const char *path, Vec<Vec3> &ps, Vec<Vec4i> &quads, Polygons &polygons) {
+	MappedFile file;
+	if (!file.open(path)) {
+		return false;
+	}
+
+	// Chunks of at least 64 KB starting on a line, a few per thread to even out the lines
+	const char *begin = file.data, *end = file.data + file.size;
+	const int n = Max(1, Min(threadCount() * 4, int(file.size >> 16)));
+	Vec<ObjChunk> chunks(n);
+	for (int i = 0; i < n; ++i) {
+		const char *start = begin;
+		if (i > 0) {
+			start = begin + file.size * i / n;
+			const char *eol = (const char*)memchr(start - 1, '\n', end - start + 1);
+			start = eol ? eol + 1 : end;
+			chunks[i - 1].end = start;
+		}
+		chunks[i].begin = start;
+	}
+	chunks[n - 1].end = end;
+
+	parallelInvoke(n, [&](int i) { countObjChunk(chunks[i]); });
+
+	ObjChunk total;
+	for (ObjChunk &c : chunks) {
+		c.firstLine = total.lines;
+		c.firstVert = total.verts;
+		c.firstQuad = total.quads;
+		c.firstPolygon = total.polygons;
+		c.firstPolygonVert = total.polygonVerts;
+		total.lines += c.lines;
+		total.verts += c.verts;
+		total.quads += c.quads;
+		total.polygons += c.polygons;
+		total.polygonVerts += c.polygonVerts;
+	}
+
+	resizeExact(ps, total.verts);
+	resizeExact(quads, total.quads);
+	resizeExact(polygons.offsets, total.polygons ? total.polygons + 1 : 0);
+	resizeExact(polygons.verts, total.polygonVerts);
+	if (total.polygons) {
+		polygons.offsets[total.polygons] = total.polygonVerts;
+	}
+
+	parallelInvoke(n, [&](int i) {
+		if (chunks[i].errorLine < 0) {
+			readObjChunk(chunks[i], total.verts, ps, quads, polygons);
+		}
+	});
+
+	for (const ObjChunk &c : chunks) {
+		if (c.errorLine >= 0) {
+			fprintf(stderr, "importObj: cannot read line %d of %s\n", c.firstLine + c.errorLine + 1, path);
+			return false;
+		}
+	}
+	return true;
+}
+
+/*
+============================================================================================
+ PLY
+============================================================================================
+*/
+enum class PlyType {
+	Int8, UInt8, Int16, UInt16, Int32, UInt32, Float32, Float64, Unknown
+};
+
+struct PlyProperty {
+	String name;
+	PlyType type = PlyType::Unknown;
+	bool list = false;
+	PlyType countType = PlyType::Unknown; // of a list
+};
+
+struct PlyElement {
+	String name;
+	long long count = 0;
+	Vec<PlyProperty> properties;
+};
+
+PlyType plyType(const String &name) {
+	static const char *NAMES[][2] = {
+		{ "char", "int8" }, { "uchar", "uint8" }, { "short", "int16" }, { "ushort", "uint16" },
+		{ "int", "int32" }, { "uint", "uint32" }, { "float", "float32" }, { "double", "float64" }
+	};
+	for (int t = 0; t < 8; ++t) {
+		if (name == NAMES[t][0] || name == NAMES[t][1]) {
+			return PlyType(t);
+		}
+	}
+	return PlyType::Unknown;
+}
+
+int plySize(PlyType type) {
+	static const int SIZES[] = { 1, 1, 2, 2, 4, 4, 4, 8, 0 };
+	return SIZES[int(type)];
+}
+
+template <class T>
+T loadPly(const unsigned char *p, bool swap) {
+	T v;
+	if (!swap) {
+		memcpy(&v, p, sizeof(T));
+		return v;
+	}
+	unsigned char bytes[sizeof(T)];
+	for (int b = 0; b < int(sizeof(T)); ++b) {
+		bytes[b] = p[sizeof(T) - 1 - b];
+	}
+	memcpy(&v, bytes, sizeof(T));
+	return v;
+}
+
+inline double plyValue(const unsigned char *p, PlyType type, bool swap) {
+	switch (type) {
+	case PlyType::Int8: return double(loadPly<int8_t>(p, swap));
+	case PlyType::UInt8: return double(loadPly<uint8_t>(p, swap));
+	case PlyType::Int16: return double(loadPly<int16_t>(p, swap));
+	case PlyType::UInt16: return double(loadPly<uint16_t>(p, swap));
+	case PlyType::Int32: return double(loadPly<int32_t>(p, swap));
+	case PlyType::UInt32: return double(loadPly<uint32_t>(p, swap));
+	case PlyType::Float32: return double(loadPly<float>(p, swap));
+	case PlyType::Float64: return loadPly<double>(p, swap);
+	default: return 0.0;
+	}
+}
+
+// Elements of the header and where the body starts. swap is set when the byte order is not the machine's.
+bool readPlyHeader(const MappedFile &file, const char *path, Vec<PlyElement> &elements, bool &swap, size_t &bodyOffset) {
+	const char *begin = file.data, *end = file.data + file.size;
+	const uint16_t one = 1;
+	const bool littleEndian = *(const unsigned char*)&one == 1;
+
+	int index = 0;
+	bool formatOk = false;
+	for (const char *line = begin; line < end; ++index) {
+		const char *eol = (const char*)memchr(line, '\n', end - line);
+		if (!eol) {
+			break;
+		}
+
+		Vec<String> words;
+		for (const char *p = line; p < eol;) {
+			while (p < eol && isBlank(*p)) {
+				++p;
+			}
+			const char *word = p;
+			while (p < eol && !isBlank(*p)) {
+				++p;
+			}
+			if (p > word) {
+				words.emplace_back(word, p);
+			}
+		}
+		line = eol + 1;
+
+		if (index == 0) {
+			if (words.size() != 1 || words[0] != "ply") {
+				fprintf(stderr, "importPly: %s is not a PLY file\n", path);
+				return false;
+			}
+		} else if (words.empty() || words[0] == "comment" || words[0] == "obj_info") {
+			continue;
+		} else if (words[0] == "format" && words.size() >= 2) {
+			if (words[1] == "binary_little_endian" || words[1] == "binary_big_endian") {
+				swap = (words[1] == "binary_little_endian") != littleEndian;
+				formatOk = true;
+			} else {
+				fprintf(stderr, "importPly: %s is %s, only binary PLY is read\n", path, words[1].c_str());
+				return false;
+			}
+		} else if (words[0] == "element" && words.size() == 3) {
+			elements.push_back({ words[1], strtoll(words[2].c_str(), nullptr, 10), {} });
+		} else if (words[0] == "property" && !elements.empty()) {
+			PlyProperty property;
+			if (words.size() == 5 && words[1] == "list") {
+				property.list = true;
+				property.countType = plyType(words[2]);
+				property.type = plyType(words[3]);
+				property.name = words[4];
+			} else if (words.size() == 3) {
+				property.type = plyType(words[1]);
+				property.name = words[2];
+			}
+			if (property.type == PlyType::Unknown || (property.list && property.countType == PlyType::Unknown)) {
+				fprintf(stderr, "importPly: unknown property on line %d of %s\n", index + 1, path);
+				return false;
+			}
+			elements.back().properties.push_back(property);
+		} else if (words[0] == "end_header") {
+			bodyOffset = line - begin;
+			if (!formatOk) {
+				fprintf(stderr, "importPly: %s has no format\n", path);
+			}
+			return formatOk;
+		} else {
+			fprintf(stderr, "importPly: cannot read line %d of %s\n", index + 1, path);
+			return false;
+		}
+	}
+	fprintf(stderr, "importPly: %s has no end_header\n", path);
+	return false;
+}
+
+int findPlyProperty(const PlyElement &element, const char *name) {
+	for (int i = 0; i < int(element.properties.size()); ++i) {
+		if (element.properties[i].name == name) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+// Past the property at p, or past end if it goes beyond. length is that of a list.
+const unsigned char* skipPlyProperty(const PlyProperty &property, const unsigned char *p, const unsigned char *end,
+	bool swap, int &length) {
+	if (!property.list) {
+		return end - p < plySize(property.type) ? end + 1 : p + plySize(property.type);
+	}
+	const int countSize = plySize(property.countType);
+	if (end - p < countSize) {
+		return end + 1;
+	}
+	const double count = plyValue(p, property.countType, swap);
+	if (count < 0.0 || count * plySize(property.type) > double(end - p - countSize)) {
+		return end + 1;
+	}
+	length = int(count);
+	return p + countSize + size_t(length) * plySize(property.type);
+}
+
+// Size of the record at p, 0 if it goes past end. listLength is the length of the list property listIndex.
+size_t plyRecordSize(const PlyElement &element, const unsigned char *p, const unsigned char *end, bool swap,
+	int listIndex, int &listLength) {
+	const unsigned char *start = p;
+	for (int i = 0; i < int(element.properties.size()) && p <= end; ++i) {
+		int length = 0;
+		p = skipPlyProperty(element.properties[i], p, end, swap, length);
+		if (i == listIndex) {
+			listLength = length;
+		}
+	}
+	return p > end ? 0 : size_t(p - start);
+}
+
+bool importPly(const char *path, Vec<Vec3> &ps, Vec<Vec4i> &quads, Polygons &polygons) {
+	MappedFile file;
+	if (!file.open(path)) {
+		return false;
+	}
+
+	Vec<PlyElement> elements;
+	bool swap = false;
+	size_t bodyOffset = 0;
+	if (!readPlyHeader(file, path, elements, swap, bodyOffset)) {
+		return false;
+	}
+
+	const unsigned char *p = (const unsigned char*)file.data + bodyOffset;
+	const unsigned char *fileEnd = (const unsigned char*)file.data + file.size;
+	bool hasVerts = false;
+	for (const PlyElement &element : elements) {
+		bool fixed = true;
+		size_t stride = 0;
+		for (const PlyProperty &property : element.properties) {
+			fixed &= !property.list;
+			stride += plySize(property.type);
+		}
+		const int listIndex = element.name == "face" ? Max(findPlyProperty(element, "vertex_indices"), findPlyProperty(element, "vertex_index")) : -1;
+		if (element.count < 0 || element.count > INT_MAX || (fixed && stride * element.count > size_t(fileEnd - p))) {
+			fprintf(stderr, "importPly: %s is cut short\n", path);
+			return false;
+		}
+		const int count = int(element.count);
+
+		if (element.name == "vertex") {
+			// Records of a fixed size, read in place
+			const int x = findPlyProperty(element, "x"), y = findPlyProperty(element, "y"), z = findPlyProperty(element, "z");
+			if (!fixed || x < 0 || y < 0 || z < 0) {
+				fprintf(stderr, "importPly: the vertices of %s have no x, y, z\n", path);
+				return false;
+			}
+			size_t offsets[3] = {};
+			const int axes[3] = { x, y, z };
+			for (int k = 0; k < 3; ++k) {
+				for (int i = 0; i < axes[k]; ++i) {
+					offsets[k] += plySize(element.properties[i].type);
+				}
+			}
+			// Floats in the machine's byte order, as most scanners write them, are copied as they are
+			bool copy = !swap;
+			for (int k = 0; k < 3; ++k) {
+				copy &= element.properties[axes[k]].type == PlyType::Float32;
+			}
+			resizeExact(ps, count);
+			parallelFor(count, [&](int begin, int end) {
+				for (int v = begin; v < end; ++v) {
+					const unsigned char *record = p + stride * v;
+					for (int k = 0; k < 3; ++k) {
+						if (copy) {
+							memcpy(&ps[v][k], record + offsets[k], sizeof(float));
+						} else {
+							ps[v][k] = float(plyValue(record + offsets[k], element.properties[axes[k]].type, swap));
+						}
+					}
+				}
+			});
+			hasVerts = true;
+			p += stride * count;
+		} else if (listIndex >= 0) {
+			// Records of any size: one pass finds where each chunk starts and what it holds, then
+			// the chunks are read in parallel as for OBJ
+			const PlyProperty &list = element.properties[listIndex];
+			const int n = Max(1, Min(threadCount() * 4, count >> 14));
+			Vec<ObjChunk> chunks(n);
+			Vec<const unsigned char*> starts(n);
+			for (int i = 0, f = 0; i < n; ++i) {
+				const Range r = splitRange(count, n, i);
+				starts[i] = p;
+				ObjChunk &c = chunks[i];
+				for (; f < r.end; ++f) {
+					int length = 0;
+					const size_t size = plyRecordSize(element, p, fileEnd, swap, listIndex, length);
+					if (size == 0 || length < 3) {
+						fprintf(stderr, "importPly: cannot read face %d of %s\n", f, path);
+						return false;
+					}
+					p += size;
+					if (length == 4) {
+						++c.quads;
+					} else {
+						++c.polygons;
+						c.polygonVerts += length;
+					}
+				}
+			}
+
+			ObjChunk total;
+			for (ObjChunk &c : chunks) {
+				c.firstQuad = total.quads;
+				c.firstPolygon = total.polygons;
+				c.firstPolygonVert = total.polygonVerts;
+				total.quads += c.quads;
+				total.polygons += c.polygons;
+				total.polygonVerts += c.polygonVerts;
+			}
+			resizeExact(quads, total.quads);
+			resizeExact(polygons.offsets, total.polygons ? total.polygons + 1 : 0);
+			resizeExact(polygons.verts, total.polygonVerts);
+			if (total.polygons) {
+				polygons.offsets[total.polygons] = total.polygonVerts;
+			}
+
+			const int countSize = plySize(list.countType), indexSize = plySize(list.type);
+			const bool copyIndices = !swap && (list.type == PlyType::Int32 || list.type == PlyType::UInt32);
+			parallelInvoke(n, [&](int i) {
+				const ObjChunk &c = chunks[i];
+				const Range r = splitRange(count, n, i);
+				const unsigned char *record = starts[i];
+				int quadCount = 0, polygonCount = 0, polygonVerts = 0;
+				for (int f = r.begin; f < r.end; ++f) {
+					// The records were checked by the first pass
+					int length = 0, unused = 0;
+					const unsigned char *indices = record;
+					for (int j = 0; j < listIndex; ++j) {
+						indices = skipPlyProperty(element.properties[j], indices, fileEnd, swap, unused);
+					}
+					record += plyRecordSize(element, record, fileEnd, swap, listIndex, length);
+					indices += countSize;
+
+					int *out;
+					if (length == 4) {
+						out = &quads[c.firstQuad + quadCount++][0];
+					} else {
+						polygons.offsets[c.firstPolygon + polygonCount++] = c.firstPolygonVert + polygonVerts;
+						out = &polygons.verts[c.firstPolygonVert + polygonVerts];
+						polygonVerts += length;
+					}
+					if (copyIndices) {
+						memcpy(out, indices, sizeof(int) * length); // past INT_MAX they turn negative, caught below
+						continue;
+					}
+					for (int k = 0; k < length; ++k) {
+						const double i = plyValue(indices + k * indexSize, list.type, swap);
+						out[k] = i >= 0.0 && i < double(INT_MAX) ? int(i) : -1;
+					}
+				}
+			});
+		} else {
+			// Anything else is skipped
+			for (int r = 0; r < count; ++r) {
+				int length = 0;
+				const size_t size = plyRecordSize(element, p, fileEnd, swap, -1, length);
+				if (size == 0 && !element.properties.empty()) {
+					fprintf(stderr, "importPly: %s is cut short\n", path);
+					return false;
+				}
+				p += size;
+			}
+		}
+	}
+
+	// Faces may come before the vertices, the indices are checked once both are there
+	if (!hasVerts) {
+		fprintf(stderr, "importPly: %s has no vertices\n", path);
+		return false;
+	}
+	const int vertCount = ps.size();
+	std::atomic<bool> indicesOk{ true };
+	parallelFor(int(quads.size()), [&](int begin, int end) {
+		for (int f = begin; f < end; ++f) {
+			for (int j = 0; j < 4; ++j) {
+				if (unsigned(quads[f][j]) >= unsigned(vertCount)) {
+					indicesOk = false;
+				}
+			}
+		}
+	});
+	for (int v : polygons.verts) {
+		if (unsigned(v) >= unsigned(vertCount)) {
+			indicesOk = false;
+		}
+	}
+	if (!indicesOk) {
+		fprintf(stderr, "importPly: %s has faces on missing vertices\n", path);
+		return false;
+	}
+	return true;
+}
+
+bool importCage(const char *path, Vec<Vec3> &ps, Vec<Vec4i> &quads, Polygons &polygons) {
+	ps.clear();
+	quads.clear();
+	polygons.clear();
+
+	const char *dot = strrchr(path, '.');
+	String extension = dot ? dot + 1 : "";
+	for (char &c : extension) {
+		c = char(tolower((unsigned char)c));
+	}
+	if (extension == "obj") {
+		return importObj(path, ps, quads, polygons);
+	}
+	if (extension == "ply") {
+		return importPly(path, ps, quads, polygons);
+	}
+	fprintf(stderr, "importCage: %s is neither .obj nor .ply\n", path);
+	return false;
+}
+
+/*
+============================================================================================
+ Polygons
+============================================================================================
+*/
+void subdividePolygons(Vec<Vec3> &ps, Vec<Vec4i> &quads, Polygons &polygons) {
+	const int n = ps.size();
+	const int quadCount = quads.size();
+	const int m = quadCount + polygons.count();
+
+	// Half-edges of the quads then of the polygons, face f owns [faceOffsets[f], faceOffsets[f + 1])
+	Vec<int> faceOffsets(m + 1);
+	for (int f = 0; f < m; ++f) {
+		faceOffsets[f] = f < quadCount ? 4 : polygons.offsets[f - quadCount + 1] - polygons.offsets[f - quadCount];
+	}
+	const int halfEdgeCount = parallelScan(faceOffsets);
+	faceOffsets[m] = halfEdgeCount;
+	auto faceVert = [&](int f, int j) {
+		return f < quadCount ? quads[f][j] : polygons.verts[polygons.offsets[f - quadCount] + j];
+	};
+
+	// Edges as the runs of half-edges sorted by their vertex pair, as buildTopology does for quads
+	const int bits = bitsFor(n);
+	Vec<SortKey> keys(halfEdgeCount);
+	Vec<int> halfEdgeFace(halfEdgeCount);
+	parallelFor(m, [&](int begin, int end) {
+		for (int f = begin; f < end; ++f) {
+			const int size = faceOffsets[f + 1] - faceOffsets[f];
+			for (int j = 0; j < size; ++j) {
+				const int h = faceOffsets[f] + j;
+				const int a = faceVert(f, j), b = faceVert(f, (j + 1) % size);
+				keys[h] = { (uint64_t(Min(a, b)) << bits) | uint64_t(Max(a, b)), h };
+				halfEdgeFace[h] = f;
+			}
+		}
+	});
+	radixSort(keys, 2 * bits);
+
+	Vec<int> halfEdgeEdge(halfEdgeCount);
+	Vec<Vec2i> edgeVerts, edgeFaces; // y is -1 on a boundary, and on edges of more than 2 faces
+	for (int i = 0; i < halfEdgeCount;) {
+		int j = i + 1;
+		while (j < halfEdgeCount && keys[j].key == keys[i].key) {
+			++j;
+		}
+		const int e = edgeVerts.size();
+		edgeVerts.push_back({ int(keys[i].key >> bits), int(keys[i].key & ((uint64_t(1) << bits) - 1)) });
+		edgeFaces.push_back({ halfEdgeFace[keys[i].value], j - i == 2 ? halfEdgeFace[keys[i + 1].value] : -1 });
+		for (; i < j; ++i) {
+			halfEdgeEdge[keys[i].value] = e;
+		}
+	}
+	const int k = edgeVerts.size();
+
+	// [old verts (n) | face points (m) | edge points (k)], the rules of subdivision_kernels.cpp
+	Vec<Vec3> childPs(size_t(n) + m + k);
+	parallelFor(m, [&](int begin, int end) {
+		for (int f = begin; f < end; ++f) {
+			const int size = faceOffsets[f + 1] - faceOffsets[f];
+			Vec3 sum(0.f);
+			for (int j = 0; j < size; ++j) {
+				sum += ps[faceVert(f, j)];
+			}
+			childPs[n + f] = sum / float(size);
+		}
+	});
+	parallelFor(k, [&](int begin, int end) {
+		for (int e = begin; e < end; ++e) {
+			const Vec2i &ev = edgeVerts[e], &ef = edgeFaces[e];
+			const Vec3 mid = ps[ev.x] + ps[ev.y];
+			childPs[n + m + e] = ef.y < 0 ? 0.5f * mid : 0.25f * (mid + childPs[n + ef.x] + childPs[n + ef.y]);
+		}
+	});
+
+	Vec<Vec3> faceSums(n, Vec3(0.f)), edgeSums(n, Vec3(0.f)), boundarySums(n, Vec3(0.f));
+	Vec<int> faceValences(n, 0), edgeValences(n, 0), boundaryValences(n, 0);
+	for (int f = 0; f < m; ++f) {
+		for (int h = faceOffsets[f]; h < faceOffsets[f + 1]; ++h) {
+			const int v = faceVert(f, h - faceOffsets[f]);
+			faceSums[v] += childPs[n + f];
+			++faceValences[v];
+		}
+	}
+	for (int e = 0; e < k; ++e) {
+		const Vec3 mid = 0.5f * (ps[edgeVerts[e].x] + ps[edgeVerts[e].y]);
+		for (int v : { edgeVerts[e].x, edgeVerts[e].y }) {
+			edgeSums[v] += mid;
+			++edgeValences[v];
+			if (edgeFaces[e].y < 0) {
+				boundarySums[v] += mid;
+				++boundaryValences[v];
+			}
+		}
+	}
+	parallelFor(n, [&](int begin, int end) {
+		for (int v = begin; v < end; ++v) {
+			const int valence = edgeValences[v];
+			if (faceValences[v] == 0) {
+				childPs[v] = ps[v];
+			} else if (valence != faceValences[v]) {
+				childPs[v] = (ps[v] + boundarySums[v]) / float(boundaryValences[v] + 1);
+			} else {
+				childPs[v] = (ps[v] * float(valence - 3) + faceSums[v] / float(valence) + 2.f * edgeSums[v] / float(valence)) / float(valence);
+			}
+		}
+	});
+
+	// A quad per corner: the corner, the point of the edge after it, the face point, the point of the edge before
+	Vec<Vec4i> childQuads(halfEdgeCount);
+	parallelFor(m, [&](int begin, int end) {
+		for (int f = begin; f < end; ++f) {
+			const int first = faceOffsets[f], size = faceOffsets[f + 1] - first;
+			for (int j = 0; j < size; ++j) {
+				const int prev = first + (j + size - 1) % size;
+				childQuads[first + j] = { faceVert(f, j), n + m + halfEdgeEdge[first + j], n + f, n + m + halfEdgeEdge[prev] };
+			}
+		}
+	});
+
+	ps.swap(childPs);
+	quads.swap(childQuads);
+	polygons.clear();
+}
@@ -2,10 +2,15 @@
 
 // C std
 #include <cmath>
+#include <cstddef>
+#include <cstring>
 
 // User
 #include "ui_engine.h"
+#include "grid_mesh.h"
 #include "mesh.h"
+#include "parallel.h"
+#include "streaming_subdivision.h"
 
 OpenGLEngine *opengl = nullptr;
 OpenGLEngine *OpenGLInit() {
@@ -41,6 +46,7 @@ void OpenGLEngine::init() {
 		glfwTerminate();
 		exit(-1);
 	}
+	bufferStorage = GLAD_GL_VERSION_4_4 != 0;
 
 	glViewport(0, 0, WIDTH, HEIGHT);
 	glfwSetFramebufferSizeCallback(window, frame_buf_size_callback);
@@ -52,12 +58,8 @@ void OpenGLEngine::init() {
 	glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
 	glEnable(GL_DEPTH_TEST);
 
-	glGenVertexArrays(1, &VAO);
-	glGenBuffers(1, &VBO);
-	glGenBuffers(1, &IBO);
-
 	mesh = newDefaultCube();
-	prepareData();
+	selectLevelBuffers();
 
 	// Prepare shader
 	program.init("shaders\\vert_std.glsl", nullptr, "shaders\\frag_std.glsl");
@@ -65,9 +67,16 @@ void OpenGLEngine::init() {
 }
 
 void OpenGLEngine::shutdown() {
-	glDeleteBuffers(1, &VBO);
-	glDeleteBuffers(1, &IBO);
-	glDeleteVertexArrays(1, &VAO);
+	cancelUpload();
+	for (LevelBuffers &buffers : levelBuffers) {
+		releaseLevelBuffers(buffers);
+	}
+	hideStreamed();
+	for (GpuBuffer &buffer : spareBuffers) {
+		deleteBuffer(buffer);
+	}
+	spareBuffers.clear();
+	deletePatchPools();
 
 	deleteDefaultCube(mesh);
 
@@ -108,6 +117,9 @@ void OpenGLEngine::render() {
 	model = glm::rotate(model, float(glm::radians(rotationZ)), glm::vec3(0.f, 0.f, 1.f));
 	model = glm::scale(model, glm::vec3(3.f, 3.f, 3.f));
 	program.setMat4("MVP", projection * view * model);
+	program.setMat4("model", model);
+	const bool normals = shownLevel >= 0 && levelBuffers[shownLevel].NBO.id && !streamedBuffers.version;
+	program.setBool("shaded", viewDependent || normals);
 
 	program.setVec3("color", Vec3(0.f, 0.8f, 0.5f));
 
@@ -115,7 +127,11 @@ void OpenGLEngine::render() {
 	glClearColor(bgColor[0], bgColor[1], bgColor[2], 1.f);
 	glDepthMask(GL_TRUE);
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-	renderData();
+	if (viewDependent) {
+		renderViewDependent(projection * view * model);
+	} else {
+		renderData();
+	}
 }
 
 void OpenGLEngine::cleanup() {
@@ -151,34 +167,521 @@ void OpenGLEngine::initCamera() {
 
 }
 
-void OpenGLEngine::prepareData() {
-	glBindVertexArray(VAO);
+// Buffer for at least bytes: the one there if it is large enough, else a spare one that is not
+// much larger, else a new one. Spares are waited for first, the GPU may still draw from them.
+void OpenGLEngine::reserveBuffer(GpuBuffer &buffer, size_t bytes) {
+	bytes = Max(bytes, size_t(64) << 10);
+	if (buffer.id && buffer.capacity >= bytes) {
+		waitBuffer(buffer);
+		return;
+	}
+	releaseBuffer(buffer);
+
+	int best = -1;
+	for (int i = 0; i < int(spareBuffers.size()); ++i) {
+		const size_t capacity = spareBuffers[i].capacity;
+		if (capacity >= bytes && capacity <= 2 * bytes && (best < 0 || capacity < spareBuffers[best].capacity)) {
+			best = i;
+		}
+	}
+	if (best >= 0) {
+		buffer = spareBuffers[best];
+		spareBuffers.erase(spareBuffers.begin() + best);
+		waitBuffer(buffer);
+		return;
+	}
+
+	glGenBuffers(1, &buffer.id);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, buffer.id);
+	buffer.capacity = bytes;
+	createdBytes += bytes;
+	if (bufferStorage) {
+		// Dynamic storage as well, cage edits write their few points through GL
+		const GLbitfield MAP_FLAGS = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(GL_COPY_WRITE_BUFFER, bytes, nullptr, MAP_FLAGS | GL_DYNAMIC_STORAGE_BIT);
+		buffer.mapped = (char*)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, bytes, MAP_FLAGS);
+	} else {
+		glBufferData(GL_COPY_WRITE_BUFFER, bytes, nullptr, GL_STATIC_DRAW);
+	}
+}
+
+// Only for buffers the GPU does not read, i.e. reserved and not drawn yet
+void OpenGLEngine::writeBuffer(GpuBuffer &buffer, size_t offset, const void *data, size_t bytes) {
+	if (buffer.mapped) {
+		memcpy(buffer.mapped + offset, data, bytes);
+		return;
+	}
+	glBindBuffer(GL_COPY_WRITE_BUFFER, buffer.id);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, offset, bytes, data);
+}
+
+// Kept for a later level behind a fence, draws issued so far may still read it
+void OpenGLEngine::releaseBuffer(GpuBuffer &buffer) {
+	if (!buffer.id) {
+		return;
+	}
+	if (!buffer.fence) {
+		buffer.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
+	spareBuffers.push_back(buffer);
+	buffer = GpuBuffer{};
+
+	size_t bytes = 0;
+	for (const GpuBuffer &spare : spareBuffers) {
+		bytes += spare.capacity;
+	}
+	while (bytes > spareBudget) {
+		bytes -= spareBuffers[0].capacity;
+		deleteBuffer(spareBuffers[0]);
+		spareBuffers.erase(spareBuffers.begin());
+	}
+}
+
+// A mapped buffer is unmapped by its deletion
+void OpenGLEngine::deleteBuffer(GpuBuffer &buffer) {
+	if (buffer.fence) {
+		glDeleteSync(buffer.fence);
+	}
+	if (buffer.id) {
+		glDeleteBuffers(1, &buffer.id);
+	}
+	buffer = GpuBuffer{};
+}
+
+void OpenGLEngine::waitBuffer(GpuBuffer &buffer) {
+	if (!buffer.fence) {
+		return;
+	}
+	// Mostly signalled already, the buffer was put aside a frame or more ago
+	while (glClientWaitSync(buffer.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ull) == GL_TIMEOUT_EXPIRED);
+	glDeleteSync(buffer.fence);
+	buffer.fence = nullptr;
+}
+
+// Fresh buffers for the current level, filled by continueUpload
+void OpenGLEngine::beginUpload() {
+	cancelUpload();
+	upload.level = mesh->level;
+	LevelBuffers &buffers = upload.buffers;
+	buffers.version = mesh->version;
+	PROFILE(LevelProfile &profile = mesh->profile.at(upload.level));
+	PROFILE(profile.phases[PhaseUpload] = PhaseStats{});
+	PROFILE(uploadTimer.open(profile, PhaseUpload, createdBytes));
+
+	const GridMesh &grid = mesh->grid;
+	Vec<unsigned int> indices;
+	if (!grid.empty()) {
+		grid.patchIndices(indices);
+		upload.pointBytes = sizeof(Vec3) * size_t(grid.patchSize() * grid.patchSize()) * grid.cageFaces.size();
+		upload.indexBytes = sizeof(unsigned int) * indices.size();
+	} else {
+		upload.pointBytes = sizeof(Vec3) * mesh->points().size();
+		upload.normalBytes = sizeof(Vec3) * mesh->normals.size();
+		upload.indexBytes = sizeof(Vec3i) * mesh->triangles().size();
+		buffers.indexCount = unsigned(3 * mesh->triangles().size());
+	}
+
+	glGenVertexArrays(1, &buffers.VAO);
+	reserveBuffer(buffers.VBO, upload.pointBytes);
+	if (upload.normalBytes) {
+		reserveBuffer(buffers.NBO, upload.normalBytes);
+	}
+	reserveBuffer(buffers.IBO, upload.indexBytes);
+	setupVertexArray(buffers);
+
+	// Every patch draws with the same few indices
+	if (!indices.empty()) {
+		writeBuffer(buffers.IBO, 0, indices.data(), upload.indexBytes);
+		upload.indicesDone = upload.indexBytes;
+		PROFILE(profile.phases[PhaseUpload].uploadedBytes += upload.indexBytes);
+	}
+}
+
+// Up to uploadBudget bytes of the level: the points, then the normals, then the triangles.
+// Copied from the mesh, whose level stays for the cache, edits and export.
+bool OpenGLEngine::continueUpload() {
+	LevelBuffers &buffers = upload.buffers;
+	size_t budget = uploadBudget;
+	PROFILE(LevelProfile &profile = mesh->profile.at(upload.level));
+	PROFILE(const size_t pointsBefore = upload.pointsDone);
+	PROFILE(const size_t bytesBefore = upload.pointsDone + upload.normalsDone + upload.indicesDone);
+	PROFILE(if (uploadTimer.phase < 0) uploadTimer.open(profile, PhaseUpload, createdBytes));
+	auto write = [&](GpuBuffer &buffer, const void *data, size_t total, size_t &done) {
+		const size_t bytes = Min(budget, total - done);
+		if (bytes) {
+			writeBuffer(buffer, done, (const char*)data + done, bytes);
+		}
+		done += bytes;
+		budget -= bytes;
+	};
+
+	if (!mesh->grid.empty()) {
+		const GridMesh &grid = mesh->grid;
+		const size_t patchBytes = sizeof(Vec3) * size_t(grid.patchSize() * grid.patchSize());
+		const int first = int(upload.pointsDone / patchBytes);
+		const int count = Min(int(grid.cageFaces.size()) - first, Max(1, int(budget / patchBytes)));
+		uploadPatchPoints(buffers.VBO, first, count);
+		upload.pointsDone += patchBytes * count;
+	} else {
+		write(buffers.VBO, mesh->points().data(), upload.pointBytes, upload.pointsDone);
+		write(buffers.NBO, mesh->normals.data(), upload.normalBytes, upload.normalsDone);
+		write(buffers.IBO, mesh->triangles().data(), upload.indexBytes, upload.indicesDone);
+	}
+	PROFILE(profile.count(PhaseUpload, (long long)((upload.pointsDone - pointsBefore) / sizeof(Vec3))));
+	PROFILE(profile.phases[PhaseUpload].uploadedBytes += upload.pointsDone + upload.normalsDone + upload.indicesDone - bytesBefore);
+	PROFILE(uploadTimer.close(profile, createdBytes));
+	return upload.pointsDone == upload.pointBytes && upload.normalsDone == upload.normalBytes &&
+		upload.indicesDone == upload.indexBytes;
+}
+
+// The uploaded level is drawn from now on, the buffers it replaces are put aside
+void OpenGLEngine::finishUpload() {
+	if (int(levelBuffers.size()) <= upload.level) {
+		levelBuffers.resize(upload.level + 1);
+	}
+	LevelBuffers &slot = levelBuffers[upload.level];
+	releaseLevelBuffers(slot);
+	slot = upload.buffers;
+	shownLevel = upload.level;
+	upload = Upload{};
+	selectPatchDraws();
+	releaseStaleLevels();
+}
+
+void OpenGLEngine::cancelUpload() {
+	PROFILE(if (upload.level >= 0) uploadTimer.close(mesh->profile.at(upload.level), createdBytes));
+	releaseLevelBuffers(upload.buffers);
+	upload = Upload{};
+}
+
+// Patches [first, first + count), their borders are copied from the shared points.
+// Straight into the mapping when there is one, through a slice otherwise.
+void OpenGLEngine::uploadPatchPoints(GpuBuffer &buffer, int first, int count) {
+	const GridMesh &grid = mesh->grid;
+	const int patchPoints = grid.patchSize() * grid.patchSize();
+	const size_t patchBytes = sizeof(Vec3) * size_t(patchPoints);
+	if (buffer.mapped) {
+		Vec3 *out = (Vec3*)(buffer.mapped + patchBytes * first);
+		parallelFor(count, [&](int begin, int end) {
+			for (int i = begin; i < end; ++i) {
+				grid.patchPoints(mesh->points(), first + i, out + size_t(patchPoints) * i);
+			}
+		});
+		return;
+	}
+
+	const int slicePatches = Max(1, int((size_t(4) << 20) / patchBytes));
+	Vec<Vec3> slice;
+	for (int done = 0; done < count; done += slicePatches) {
+		const int n = Min(slicePatches, count - done);
+		slice.resize(size_t(patchPoints) * n);
+		for (int i = 0; i < n; ++i) {
+			grid.patchPoints(mesh->points(), first + done + i, &slice[size_t(patchPoints) * i]);
+		}
+		writeBuffer(buffer, patchBytes * (first + done), slice.data(), sizeOf(slice));
+	}
+}
+
+void OpenGLEngine::selectPatchDraws() {
+	const GridMesh &grid = mesh->grid;
+	if (grid.empty()) {
+		patchCounts.clear();
+		patchOffsets.clear();
+		patchBaseVertices.clear();
+		return;
+	}
+	const int faceCount = int(grid.cageFaces.size());
+	const int n = grid.patchSize() - 1;
+	patchCounts.assign(faceCount, 6 * n * n);
+	patchOffsets.assign(faceCount, nullptr);
+	patchBaseVertices.resize(faceCount);
+	for (int f = 0; f < faceCount; ++f) {
+		patchBaseVertices[f] = f * (n + 1) * (n + 1);
+	}
+}
+
+// Shows the buffers of the current level if they hold its version, starts uploading it otherwise.
+// Small levels are uploaded at once, larger ones over the next frames.
+void OpenGLEngine::selectLevelBuffers() {
+	if (int(levelBuffers.size()) <= mesh->level) {
+		levelBuffers.resize(mesh->level + 1);
+	}
+
+	if (levelBuffers[mesh->level].version == mesh->version) {
+		cancelUpload();
+		shownLevel = mesh->level;
+		selectPatchDraws();
+	} else if (upload.level != mesh->level || upload.buffers.version != mesh->version) {
+		beginUpload();
+		if (continueUpload()) {
+			finishUpload();
+		}
+	}
+	releaseStaleLevels();
+}
+
+// Buffers of levels the mesh dropped or changed are put aside, the shown ones once replaced
+void OpenGLEngine::releaseStaleLevels() {
+	for (int l = 0; l < int(levelBuffers.size()); ++l) {
+		LevelBuffers &buffers = levelBuffers[l];
+		const unsigned int version = (l == mesh->level) ? mesh->version : mesh->cachedVersion(l);
+		if (buffers.version != version && l != shownLevel) {
+			releaseLevelBuffers(buffers);
+		}
+	}
+}
 
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeOf(mesh->points()), dataOf(mesh->points()), GL_STATIC_DRAW);
+void OpenGLEngine::setupVertexArray(const LevelBuffers &buffers) {
+	glBindVertexArray(buffers.VAO);
+	glBindBuffer(GL_ARRAY_BUFFER, buffers.VBO.id);
 	glVertexAttribPointer(0, Mesh::TRI_FACE_VERTS, GL_FLOAT, false, Mesh::TRI_FACE_VERTS * sizeof(float), 0);
 	glEnableVertexAttribArray(0);
+	if (buffers.NBO.id) {
+		glBindBuffer(GL_ARRAY_BUFFER, buffers.NBO.id);
+		glVertexAttribPointer(1, 3, GL_FLOAT, false, 3 * sizeof(float), 0);
+		glEnableVertexAttribArray(1);
+	} else {
+		glDisableVertexAttribArray(1);
+	}
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers.IBO.id);
+	glBindVertexArray(0);
+}
 
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, IBO);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeOf(mesh->triFaces), dataOf(mesh->triFaces), GL_STATIC_DRAW);
+void OpenGLEngine::releaseLevelBuffers(LevelBuffers &buffers) {
+	if (buffers.VAO) {
+		glDeleteVertexArrays(1, &buffers.VAO);
+	}
+	releaseBuffer(buffers.VBO);
+	releaseBuffer(buffers.NBO);
+	releaseBuffer(buffers.IBO);
+	buffers = LevelBuffers{};
+}
 
-	glBindVertexArray(0);
+bool OpenGLEngine::showStreamed(const char *path) {
+	StreamedMesh streamed;
+	if (!streamed.open(path)) {
+		return false;
+	}
+	if (streamed.quadCount() > (1ll << 31) / 6) {
+		fprintf(stderr, "showStreamed: %lld quads are too many to draw\n", streamed.quadCount());
+		return false;
+	}
+
+	hideStreamed();
+	LevelBuffers &buffers = streamedBuffers;
+	const long long quadCount = streamed.quadCount();
+	const size_t pointBytes = sizeof(Vec3) * size_t(streamed.vertCount());
+	glGenVertexArrays(1, &buffers.VAO);
+	reserveBuffer(buffers.VBO, pointBytes);
+	reserveBuffer(buffers.IBO, 2 * sizeof(Vec3i) * size_t(quadCount));
+	setupVertexArray(buffers);
+
+	// Pages of the file are dropped behind every slice, so the whole level is never resident
+	const size_t SLICE = size_t(16) << 20;
+	const char *points = (const char*)streamed.points();
+	for (size_t done = 0; done < pointBytes; done += SLICE) {
+		const size_t bytes = Min(SLICE, pointBytes - done);
+		writeBuffer(buffers.VBO, done, points + done, bytes);
+		streamed.file.release(points - streamed.file.data + done, bytes);
+	}
+
+	// Quads are split in triangles a slice at a time, straight into the mapping if there is one
+	const long long sliceQuads = SLICE / sizeof(Vec4i);
+	Vec<Vec3i> tris;
+	for (long long done = 0; done < quadCount; done += sliceQuads) {
+		const long long count = Min(sliceQuads, quadCount - done);
+		const size_t offset = 2 * sizeof(Vec3i) * size_t(done);
+		if (buffers.IBO.mapped) {
+			triangulate(streamed.quads() + done, int(count), (Vec3i*)(buffers.IBO.mapped + offset));
+		} else {
+			tris.resize(size_t(2 * count));
+			triangulate(streamed.quads() + done, int(count), tris.data());
+			writeBuffer(buffers.IBO, offset, tris.data(), sizeOf(tris));
+		}
+		streamed.file.release((const char*)(streamed.quads() + done) - streamed.file.data, sizeof(Vec4i) * size_t(count));
+	}
+
+	buffers.version = 1;
+	buffers.indexCount = unsigned(6 * quadCount);
+	return true;
+}
+
+void OpenGLEngine::hideStreamed() {
+	releaseLevelBuffers(streamedBuffers);
+}
+
+bool OpenGLEngine::importMesh(const char *path) {
+	return mesh->importMesh(path);
 }
 
 void OpenGLEngine::renderData() {
+	mesh->pollSubdivision();
+	if (mesh->subdivided || mesh->pointsMoved) {
+		hideStreamed();
+	}
+	if (streamedBuffers.version) {
+		glBindVertexArray(streamedBuffers.VAO);
+		glDrawElements(GL_TRIANGLES, streamedBuffers.indexCount, GL_UNSIGNED_INT, 0);
+		return;
+	}
+
 	if (mesh->subdivided) {
 		mesh->subdivided = false;
-		glDeleteBuffers(1, &VBO);
-		glDeleteBuffers(1, &IBO);
+		mesh->pointsMoved = false;
+		selectLevelBuffers();
+	} else if (mesh->pointsMoved) {
+		// Cage edit, only the positions of the dirty ranges changed. They go through GL, the GPU may
+		// be drawing from the mapping. Grids and levels still uploading are uploaded again instead.
+		mesh->pointsMoved = false;
+		if (mesh->grid.empty() && shownLevel == mesh->level && upload.level < 0) {
+			LevelBuffers &buffers = levelBuffers[mesh->level];
+			PROFILE(LevelProfile &profile = mesh->profile.at(mesh->level));
+			PROFILE(uploadTimer.open(profile, PhaseUpload, createdBytes));
+			for (const Vec2i &r : mesh->dirtyRanges) {
+				const GLintptr offset = sizeof(Vec3) * r.x;
+				const GLsizeiptr size = sizeof(Vec3) * (r.y - r.x);
+				glBindBuffer(GL_COPY_WRITE_BUFFER, buffers.VBO.id);
+				glBufferSubData(GL_COPY_WRITE_BUFFER, offset, size, mesh->points().data() + r.x);
+				if (buffers.NBO.id) {
+					glBindBuffer(GL_COPY_WRITE_BUFFER, buffers.NBO.id);
+					glBufferSubData(GL_COPY_WRITE_BUFFER, offset, size, mesh->normals.data() + r.x);
+				}
+				PROFILE(profile.count(PhaseUpload, r.y - r.x));
+				PROFILE(profile.phases[PhaseUpload].uploadedBytes += size * (buffers.NBO.id ? 2 : 1));
+			}
+			PROFILE(uploadTimer.close(profile, createdBytes));
+			buffers.version = mesh->version;
+		}
+		selectLevelBuffers(); // frees the buffers of the levels the edit changed
+	} else if (upload.level >= 0) {
+		if (upload.level != mesh->level || upload.buffers.version != mesh->version) {
+			selectLevelBuffers();
+		} else if (continueUpload()) {
+			finishUpload();
+		}
+	}
+	mesh->dirtyRanges.clear();
 
-		glGenBuffers(1, &VBO);
-		glGenBuffers(1, &IBO);
+	if (shownLevel < 0) {
+		return;
+	}
+	glBindVertexArray(levelBuffers[shownLevel].VAO);
+	if (!patchCounts.empty()) {
+		glMultiDrawElementsBaseVertex(GL_TRIANGLES, patchCounts.data(), GL_UNSIGNED_INT, patchOffsets.data(),
+			int(patchCounts.size()), patchBaseVertices.data());
+		return;
+	}
+	glDrawElements(GL_TRIANGLES, levelBuffers[shownLevel].indexCount, GL_UNSIGNED_INT, 0);
+}
+
+// Levels follow the view every frame, only the patches that changed are written to their pool
+void OpenGLEngine::renderViewDependent(const glm::mat4 &mvp) {
+	mesh->pollSubdivision();
+	ViewTessellation &tessellation = viewTessellation;
+	patchesUploaded = 0;
+	if (tessellation.update(mesh->cagePoints(), mesh->cageQuads(), mesh->limitEvaluator(), mvp, WIDTH, HEIGHT)) {
+		if (patchSlots.size() != tessellation.levels.size()) {
+			deletePatchPools();
+			patchSlots.assign(tessellation.levels.size(), Vec2i(-1));
+		}
+
+		for (int f : tessellation.changed) {
+			Vec2i &slot = patchSlots[f];
+			if (slot.x != tessellation.levels[f]) {
+				if (slot.x >= 0) {
+					patchPools[slot.x].freeSlots.push_back(slot.y);
+				}
+				slot = { tessellation.levels[f], allocatePatch(tessellation.levels[f]) };
+			}
+			const Vec<PatchVertex> &patch = tessellation.patches[f];
+			glBindBuffer(GL_ARRAY_BUFFER, patchPools[slot.x].VBO);
+			glBufferSubData(GL_ARRAY_BUFFER, sizeof(PatchVertex) * patch.size() * slot.y, sizeOf(patch), dataOf(patch));
+		}
+		patchesUploaded = int(tessellation.changed.size());
+
+		for (PatchPool &pool : patchPools) {
+			pool.counts.clear();
+			pool.offsets.clear();
+			pool.baseVertices.clear();
+		}
+		for (const Vec2i &slot : patchSlots) {
+			const int n = 1 << slot.x;
+			PatchPool &pool = patchPools[slot.x];
+			pool.counts.push_back(6 * n * n);
+			pool.offsets.push_back(nullptr);
+			pool.baseVertices.push_back(slot.y * (n + 1) * (n + 1));
+		}
+	}
+
+	for (const PatchPool &pool : patchPools) {
+		if (pool.counts.empty()) {
+			continue;
+		}
+		glBindVertexArray(pool.VAO);
+		glMultiDrawElementsBaseVertex(GL_TRIANGLES, pool.counts.data(), GL_UNSIGNED_INT, pool.offsets.data(),
+			int(pool.counts.size()), pool.baseVertices.data());
+	}
+}
 
-		prepareData();
+// Slot for a patch of the given level, its pool doubles when it is full
+int OpenGLEngine::allocatePatch(int level) {
+	if (int(patchPools.size()) <= level) {
+		patchPools.resize(level + 1);
+	}
+	PatchPool &pool = patchPools[level];
+	if (!pool.freeSlots.empty()) {
+		const int slot = pool.freeSlots.back();
+		pool.freeSlots.pop_back();
+		return slot;
 	}
 
-	glBindVertexArray(VAO);
-	glDrawElements(GL_TRIANGLES, countOfElements(mesh->triFaces), GL_UNSIGNED_INT, 0);
+	if (pool.slotCount == pool.capacity) {
+		const int row = (1 << level) + 1;
+		const size_t slotBytes = sizeof(PatchVertex) * row * row;
+		const int capacity = Max(16, 2 * pool.capacity);
+		unsigned int VBO;
+		glGenBuffers(1, &VBO);
+		glBindBuffer(GL_ARRAY_BUFFER, VBO);
+		glBufferData(GL_ARRAY_BUFFER, slotBytes * capacity, nullptr, GL_DYNAMIC_DRAW);
+		if (pool.capacity) {
+			glBindBuffer(GL_COPY_READ_BUFFER, pool.VBO);
+			glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_ARRAY_BUFFER, 0, 0, slotBytes * pool.capacity);
+			glDeleteBuffers(1, &pool.VBO);
+		} else {
+			// Every patch of the level draws with the same indices
+			Vec<unsigned int> indices;
+			gridIndices(level, indices);
+			glGenVertexArrays(1, &pool.VAO);
+			glGenBuffers(1, &pool.IBO);
+			glBindVertexArray(pool.VAO);
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, pool.IBO);
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeOf(indices), dataOf(indices), GL_STATIC_DRAW);
+		}
+		pool.VBO = VBO;
+		pool.capacity = capacity;
+
+		glBindVertexArray(pool.VAO);
+		glBindBuffer(GL_ARRAY_BUFFER, pool.VBO);
+		glVertexAttribPointer(0, 3, GL_FLOAT, false, sizeof(PatchVertex), 0);
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(1, 3, GL_FLOAT, false, sizeof(PatchVertex), (void*)offsetof(PatchVertex, normal));
+		glEnableVertexAttribArray(1);
+		glBindVertexArray(0);
+	}
+	return pool.slotCount++;
+}
+
+void OpenGLEngine::deletePatchPools() {
+	for (PatchPool &pool : patchPools) {
+		if (pool.capacity == 0) {
+			continue;
+		}
+		glDeleteBuffers(1, &pool.VBO);
+		glDeleteBuffers(1, &pool.IBO);
+		glDeleteVertexArrays(1, &pool.VAO);
+	}
+	patchPools.clear();
+	patchSlots.clear();
 }
 
 void OpenGLEngine::frame_buf_size_callback(GLFWwindow *window, int w, int h) {
@@ -219,8 +722,9 @@ void OpenGLEngine::key_callback(GLFWwindow* window, int key, int scancode, int a
 		flags.LShiftDown = pressed;
 		break;
 	case GLFW_KEY_S:
-		if (pressed && !flags.keySDown) {
-			opengl->mesh->subdivide();
+		// ImGui forwards the keys typed into its text fields too, a path with an s in it is no shortcut
+		if (pressed && !flags.keySDown && !ImGui::GetIO().WantCaptureKeyboard) {
+			opengl->mesh->subdivideAsync();
 		}
 		flags.keySDown = pressed;
 		break;
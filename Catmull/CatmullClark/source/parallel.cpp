@@ -0,0 +1,253 @@
+#include "parallel.h"
+
+// C++ std
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+// Persistent workers waiting for jobs. A job is a function called for the indices [0, size).
+// The submitting thread takes part in the job and returns only after every worker left it,
+// so a worker can never pick up indices of the next job with the previous function.
+struct ThreadPool {
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+	std::mutex submitMutex;
+	Vec<std::thread> workers;
+
+	const std::function<void(int)> *job = nullptr;
+	int jobSize = 0;
+	std::atomic<int> next{ 0 };
+	unsigned long long generation = 0;
+	int busy = 0;
+	bool quit = false;
+
+public:
+	~ThreadPool() {
+		stop();
+	}
+
+	void start(int count);
+	void stop();
+	void run(int n, const std::function<void(int)> &fn);
+
+private:
+	void work(const std::function<void(int)> &fn, int size);
+	void workerLoop();
+};
+
+thread_local bool insideWorker = false;
+
+void ThreadPool::start(int count) {
+	quit = false;
+	for (int i = 0; i < count; ++i) {
+		workers.emplace_back(&ThreadPool::workerLoop, this);
+	}
+}
+
+void ThreadPool::stop() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		quit = true;
+	}
+	wake.notify_all();
+	for (auto &w : workers) {
+		w.join();
+	}
+	workers.clear();
+}
+
+void ThreadPool::work(const std::function<void(int)> &fn, int size) {
+	for (int i = next++; i < size; i = next++) {
+		fn(i);
+	}
+}
+
+void ThreadPool::workerLoop() {
+	insideWorker = true;
+	unsigned long long seen = 0;
+	while (true) {
+		const std::function<void(int)> *fn = nullptr;
+		int size = 0;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [&] { return quit || generation != seen; });
+			if (quit) {
+				return;
+			}
+			seen = generation;
+			// Woke up after the job was already finished
+			if (!job) {
+				continue;
+			}
+			fn = job;
+			size = jobSize;
+			++busy;
+		}
+
+		work(*fn, size);
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			--busy;
+		}
+		done.notify_one();
+	}
+}
+
+void ThreadPool::run(int n, const std::function<void(int)> &fn) {
+	std::unique_lock<std::mutex> submit(submitMutex, std::try_to_lock);
+	if (insideWorker || workers.empty() || !submit.owns_lock()) {
+		for (int i = 0; i < n; ++i) {
+			fn(i);
+		}
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		job = &fn;
+		jobSize = n;
+		next = 0;
+		++generation;
+	}
+	wake.notify_all();
+
+	work(fn, n);
+
+	// Indices are all taken, wait for the workers still running theirs
+	std::unique_lock<std::mutex> lock(mutex);
+	done.wait(lock, [&] { return busy == 0; });
+	job = nullptr;
+	jobSize = 0;
+}
+
+std::atomic<int> configuredThreads{ 0 };
+// Each parallelInvoke holds the pool for its whole run, a pool replaced meanwhile goes with its last job
+std::shared_ptr<ThreadPool> pool;
+std::mutex poolMutex; // The pool may be first used from several threads
+
+int threadCount() {
+	if (configuredThreads <= 0) {
+		const unsigned int n = std::thread::hardware_concurrency();
+		configuredThreads = n ? int(n) : 1;
+	}
+	return configuredThreads;
+}
+
+void setThreadCount(int n) {
+	n = Max(1, n);
+	std::shared_ptr<ThreadPool> old;
+	{
+		std::lock_guard<std::mutex> lock(poolMutex);
+		if (n == configuredThreads && pool) {
+			return;
+		}
+		old = std::move(pool);
+		configuredThreads = n;
+	}
+	// Stopped here unless a job still runs on it, outside the lock as stopping joins the workers
+	old.reset();
+}
+
+void parallelInvoke(int n, const std::function<void(int)> &fn) {
+	if (n <= 1) {
+		if (n == 1) {
+			fn(0);
+		}
+		return;
+	}
+
+	std::shared_ptr<ThreadPool> p;
+	{
+		std::lock_guard<std::mutex> lock(poolMutex);
+		if (!pool) {
+			pool = std::make_shared<ThreadPool>();
+			pool->start(threadCount() - 1);
+		}
+		p = pool;
+	}
+	p->run(n, fn);
+}
+
+int parallelScan(Vec<int> &values, int grain) {
+	const int count = values.size();
+	const int n = rangeCount(count, grain);
+
+	Vec<int> sums(n + 1, 0);
+	parallelInvoke(n, [&](int t) {
+		const Range r = splitRange(count, n, t);
+		int sum = 0;
+		for (int i = r.begin; i < r.end; ++i) {
+			sum += values[i];
+		}
+		sums[t + 1] = sum;
+	});
+	for (int t = 0; t < n; ++t) {
+		sums[t + 1] += sums[t];
+	}
+
+	parallelInvoke(n, [&](int t) {
+		const Range r = splitRange(count, n, t);
+		int sum = sums[t];
+		for (int i = r.begin; i < r.end; ++i) {
+			const int v = values[i];
+			values[i] = sum;
+			sum += v;
+		}
+	});
+
+	return sums[n];
+}
+
+int bitsFor(int count) {
+	int bits = 1;
+	while (bits < 31 && (1 << bits) < count) {
+		++bits;
+	}
+	return bits;
+}
+
+void radixSort(Vec<SortKey> &keys, int keyBits) {
+	const int DIGIT_BITS = 11;
+	const int BUCKETS = 1 << DIGIT_BITS;
+	const int count = keys.size();
+	const int n = rangeCount(count);
+
+	Vec<SortKey> tmp(count);
+	Vec<int> offsets(n * BUCKETS);
+
+	for (int shift = 0; shift < keyBits; shift += DIGIT_BITS) {
+		parallelInvoke(n, [&](int t) {
+			int *hist = &offsets[t * BUCKETS];
+			std::fill(hist, hist + BUCKETS, 0);
+			const Range r = splitRange(count, n, t);
+			for (int i = r.begin; i < r.end; ++i) {
+				++hist[(keys[i].key >> shift) & (BUCKETS - 1)];
+			}
+		});
+
+		// Bucket-major, range-minor exclusive scan keeps the sort stable
+		int sum = 0;
+		for (int b = 0; b < BUCKETS; ++b) {
+			for (int t = 0; t < n; ++t) {
+				const int c = offsets[t * BUCKETS + b];
+				offsets[t * BUCKETS + b] = sum;
+				sum += c;
+			}
+		}
+
+		parallelInvoke(n, [&](int t) {
+			int *dst = &offsets[t * BUCKETS];
+			const Range r = splitRange(count, n, t);
+			for (int i = r.begin; i < r.end; ++i) {
+				tmp[dst[(keys[i].key >> shift) & (BUCKETS - 1)]++] = keys[i];
+			}
+		});
+
+		keys.swap(tmp);
+	}
+}
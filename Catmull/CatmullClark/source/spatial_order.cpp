@@ -0,0 +1,127 @@
+#include "spatial_order.h"
+
+// C++ std
+#include <algorithm>
+
+#include "mesh.h"
+#include "parallel.h"
+
+const int MORTON_BITS = 30;
+
+// Spread the lowest 10 bits of x over every third bit
+inline unsigned int spreadBits(unsigned int x) {
+	x &= 0x3FF;
+	x = (x | (x << 16)) & 0x030000FF;
+	x = (x | (x << 8)) & 0x0300F00F;
+	x = (x | (x << 4)) & 0x030C30C3;
+	x = (x | (x << 2)) & 0x09249249;
+	return x;
+}
+
+void MortonGrid::fit(const Vec<Vec3> &ps) {
+	Vec3 hi = ps.empty() ? Vec3(0.f) : ps[0];
+	lo = hi;
+	for (const Vec3 &p : ps) {
+		lo = glm::min(lo, p);
+		hi = glm::max(hi, p);
+	}
+	scale = 1023.f / glm::max(hi - lo, Vec3(1e-20f));
+}
+
+unsigned int MortonGrid::code(const Vec3 &p) const {
+	const Vec3 q = glm::clamp((p - lo) * scale, Vec3(0.f), Vec3(1023.f));
+	return spreadBits(unsigned(q.x)) | spreadBits(unsigned(q.y)) << 1 | spreadBits(unsigned(q.z)) << 2;
+}
+
+inline Vec3 faceCenter(const Vec<Vec3> &ps, const Vec4i &face) {
+	return 0.25f * (ps[face[0]] + ps[face[1]] + ps[face[2]] + ps[face[3]]);
+}
+
+Vec<int> mortonOrder(const Vec<Vec3> &ps, const Vec<Vec4i> &faces) {
+	MortonGrid grid;
+	grid.fit(ps);
+
+	Vec<std::pair<unsigned int, int>> keys(faces.size());
+	for (int f = 0; f < int(faces.size()); ++f) {
+		keys[f] = { grid.code(faceCenter(ps, faces[f])), f };
+	}
+	std::sort(keys.begin(), keys.end());
+
+	Vec<int> order(faces.size());
+	for (int i = 0; i < int(order.size()); ++i) {
+		order[i] = keys[i].second;
+	}
+	return order;
+}
+
+void spatialOrder(const Vec<Vec3> &ps, Vec<int> &vertOrder) {
+	MortonGrid grid;
+	grid.fit(ps);
+
+	Vec<SortKey> keys(ps.size());
+	parallelFor(ps.size(), [&](int begin, int end) {
+		for (int v = begin; v < end; ++v) {
+			keys[v] = { grid.code(ps[v]), v };
+		}
+	});
+	radixSort(keys, MORTON_BITS);
+
+	resizeExact(vertOrder, keys.size());
+	parallelFor(keys.size(), [&](int begin, int end) {
+		for (int i = begin; i < end; ++i) {
+			vertOrder[keys[i].value] = i;
+		}
+	});
+}
+
+// CSR relation with its rows moved to their new positions
+void reorderRows(const Vec<int> &order, Vec<int> &offsets, Vec<int> &entries) {
+	const int count = int(order.size());
+	Vec<int> newOffsets(count + 1, 0);
+	parallelFor(count, [&](int begin, int end) {
+		for (int v = begin; v < end; ++v) {
+			newOffsets[order[v]] = offsets[v + 1] - offsets[v];
+		}
+	});
+	parallelScan(newOffsets);
+
+	Vec<int> newEntries(entries.size());
+	parallelFor(count, [&](int begin, int end) {
+		for (int v = begin; v < end; ++v) {
+			std::copy(entries.begin() + offsets[v], entries.begin() + offsets[v + 1], newEntries.begin() + newOffsets[order[v]]);
+		}
+	});
+	offsets.swap(newOffsets);
+	entries.swap(newEntries);
+}
+
+void reorderVertices(const Vec<int> &vertOrder, Vec<Vec3> &ps, Vec<Vec4i> &faces, Topology &topology) {
+	Vec<Vec3> newPs(ps.size());
+	parallelFor(ps.size(), [&](int begin, int end) {
+		for (int v = begin; v < end; ++v) {
+			newPs[vertOrder[v]] = ps[v];
+		}
+	});
+	ps.swap(newPs);
+
+	parallelFor(faces.size(), [&](int begin, int end) {
+		for (int f = begin; f < end; ++f) {
+			for (int j = 0; j < Mesh::QUAD_FACE_VERTS; ++j) {
+				faces[f][j] = vertOrder[faces[f][j]];
+			}
+		}
+	});
+
+	if (topology.vertCount != int(vertOrder.size())) {
+		return;
+	}
+	parallelFor(topology.edgeCount(), [&](int begin, int end) {
+		for (int e = begin; e < end; ++e) {
+			Vec2i &ev = topology.edgeVerts[e];
+			ev = { vertOrder[ev.x], vertOrder[ev.y] };
+		}
+	});
+	reorderRows(vertOrder, topology.vertEdgeOffsets, topology.vertEdges);
+	reorderRows(vertOrder, topology.vertFaceOffsets, topology.vertFaces);
+	topology.vertexRuns.clear(); // The classes are scattered now, the vertex pass takes them vertex by vertex
+}
@@ -0,0 +1,224 @@
+#include "stencil_table.h"
+
+// C++ std
+#include <algorithm>
+
+#include "mesh.h"
+#include "parallel.h"
+#include "simd.h"
+#include "subdivision_kernels.h"
+#include "topology.h"
+
+void childWeights(const Vec<Vec4i> &faces, const Topology &topology, int c, Vec<Weight> &out) {
+	const int n = topology.vertCount;
+	const int m = topology.faceCount();
+	const int Q = Mesh::QUAD_FACE_VERTS;
+	out.clear();
+
+	if (c >= n + m) { // edge point
+		const int e = c - n - m;
+		const Vec2i edge = topology.edgeVerts[e];
+		if (topology.isBoundaryEdge(e)) {
+			out.push_back({ edge.x, 0.5f });
+			out.push_back({ edge.y, 0.5f });
+			return;
+		}
+		out.push_back({ edge.x, 0.25f });
+		out.push_back({ edge.y, 0.25f });
+		for (int i = 0; i < 2; ++i) {
+			const Vec4i &face = faces[topology.edgeFaces[e][i]];
+			for (int j = 0; j < Q; ++j) {
+				out.push_back({ face[j], 1.f / 16.f });
+			}
+		}
+		return;
+	}
+
+	if (c >= n) { // face point
+		const Vec4i &face = faces[c - n];
+		for (int j = 0; j < Q; ++j) {
+			out.push_back({ face[j], 0.25f });
+		}
+		return;
+	}
+
+	const int v = c;
+	const int eBegin = topology.vertEdgeOffsets[v];
+	const int eEnd = topology.vertEdgeOffsets[v + 1];
+	const int fBegin = topology.vertFaceOffsets[v];
+	const int fEnd = topology.vertFaceOffsets[v + 1];
+
+	if (fBegin == fEnd) { // isolated vertex
+		out.push_back({ v, 1.f });
+		return;
+	}
+
+	if (!topology.isBoundaryVert(v)) {
+		// (P * (n - 3) + avgFaces + 2 * avgEdgeMids) / n
+		const float valence = float(eEnd - eBegin);
+		const float faceCount = float(fEnd - fBegin);
+		out.push_back({ v, (valence - 3.f) / valence });
+		for (int i = fBegin; i < fEnd; ++i) {
+			const Vec4i &face = faces[topology.vertFaces[i]];
+			for (int j = 0; j < Q; ++j) {
+				out.push_back({ face[j], 1.f / (4.f * faceCount * valence) });
+			}
+		}
+		for (int i = eBegin; i < eEnd; ++i) {
+			const Vec2i edge = topology.edgeVerts[topology.vertEdges[i]];
+			out.push_back({ edge.x, 1.f / (valence * valence) });
+			out.push_back({ edge.y, 1.f / (valence * valence) });
+		}
+		return;
+	}
+
+	// (P + sum of boundary edge mids) / (cnt + 1)
+	int cnt = 0;
+	for (int i = eBegin; i < eEnd; ++i) {
+		cnt += topology.isBoundaryEdge(topology.vertEdges[i]);
+	}
+	const float w = 1.f / float(cnt + 1);
+	out.push_back({ v, w });
+	for (int i = eBegin; i < eEnd; ++i) {
+		const int e = topology.vertEdges[i];
+		if (topology.isBoundaryEdge(e)) {
+			out.push_back({ topology.edgeVerts[e].x, 0.5f * w });
+			out.push_back({ topology.edgeVerts[e].y, 0.5f * w });
+		}
+	}
+}
+
+// Stencils of one range of child vertices, concatenated afterwards
+struct StencilChunk {
+	Vec<int> sizes;
+	Vec<int> indices;
+	Vec<float> weights;
+};
+
+void StencilTable::build(const Vec<Vec4i> &cageFaces, int cageVerts, int lvls) {
+	cageVertCount = cageVerts;
+	levels = lvls;
+
+	// Level 0 is the identity
+	offsets.resize(cageVerts + 1);
+	indices.resize(cageVerts);
+	weights.assign(cageVerts, 1.f);
+	for (int i = 0; i < cageVerts; ++i) {
+		offsets[i] = i;
+		indices[i] = i;
+	}
+	offsets[cageVerts] = cageVerts;
+
+	Vec<Vec4i> faces = cageFaces;
+	Topology topology;
+	buildTopology(faces, cageVerts, topology);
+
+	for (int level = 0; level < lvls; ++level) {
+		const int childCount = topology.vertCount + topology.faceCount() + topology.edgeCount();
+		const int n = rangeCount(childCount, 1024);
+		Vec<StencilChunk> chunks(n);
+
+		parallelInvoke(n, [&](int t) {
+			StencilChunk &chunk = chunks[t];
+			Vec<Weight> rule;
+			Vec<float> acc(cageVerts, 0.f);
+			Vec<char> used(cageVerts, 0);
+			Vec<int> touched;
+
+			const Range r = splitRange(childCount, n, t);
+			chunk.sizes.resize(r.end - r.begin);
+			for (int c = r.begin; c < r.end; ++c) {
+				childWeights(faces, topology, c, rule);
+				for (const Weight &pw : rule) {
+					for (int j = offsets[pw.vert]; j < offsets[pw.vert + 1]; ++j) {
+						const int idx = indices[j];
+						if (!used[idx]) {
+							used[idx] = 1;
+							touched.push_back(idx);
+						}
+						acc[idx] += pw.weight * weights[j];
+					}
+				}
+
+				std::sort(touched.begin(), touched.end());
+				for (int idx : touched) {
+					chunk.indices.push_back(idx);
+					chunk.weights.push_back(acc[idx]);
+					acc[idx] = 0.f;
+					used[idx] = 0;
+				}
+				chunk.sizes[c - r.begin] = touched.size();
+				touched.clear();
+			}
+		});
+
+		// Concatenate the chunks in order
+		Vec<int> newOffsets(childCount + 1);
+		newOffsets[0] = 0;
+		for (int t = 0, c = 0; t < n; ++t) {
+			for (int size : chunks[t].sizes) {
+				newOffsets[c + 1] = newOffsets[c] + size;
+				++c;
+			}
+		}
+
+		Vec<int> newIndices(newOffsets[childCount]);
+		Vec<float> newWeights(newOffsets[childCount]);
+		parallelInvoke(n, [&](int t) {
+			const int first = newOffsets[splitRange(childCount, n, t).begin];
+			std::copy(chunks[t].indices.begin(), chunks[t].indices.end(), newIndices.begin() + first);
+			std::copy(chunks[t].weights.begin(), chunks[t].weights.end(), newWeights.begin() + first);
+		});
+
+		offsets.swap(newOffsets);
+		indices.swap(newIndices);
+		weights.swap(newWeights);
+
+		if (level + 1 < lvls) {
+			Vec<Vec4i> childFaces;
+			Topology child;
+			refineTopology(faces, topology, childFaces, child);
+			faces.swap(childFaces);
+			topology = std::move(child);
+		}
+	}
+}
+
+void StencilTable::evaluate(const Vec<Vec3> &cage, Vec<Vec3> &out) const {
+	const int count = refinedVertCount();
+	out.resize(count);
+
+#ifdef SIMD_X64
+	if (simdPath() != SimdPath::Scalar) {
+		// Pad the cage to 4 floats so every point is one SSE load
+		Vec<Vec4> cage4(cage.size());
+		for (int i = 0; i < int(cage.size()); ++i) {
+			cage4[i] = Vec4(cage[i], 0.f);
+		}
+
+		parallelFor(count, [&](int begin, int end) {
+			for (int i = begin; i < end; ++i) {
+				__m128 acc = _mm_setzero_ps();
+				for (int j = offsets[i]; j < offsets[i + 1]; ++j) {
+					const __m128 p = _mm_loadu_ps(&cage4[indices[j]].x);
+					acc = _mm_add_ps(acc, _mm_mul_ps(p, _mm_set1_ps(weights[j])));
+				}
+				alignas(16) float res[4];
+				_mm_store_ps(res, acc);
+				out[i] = { res[0], res[1], res[2] };
+			}
+		});
+		return;
+	}
+#endif
+
+	parallelFor(count, [&](int begin, int end) {
+		for (int i = begin; i < end; ++i) {
+			Vec3 acc{ 0.f, 0.f, 0.f };
+			for (int j = offsets[i]; j < offsets[i + 1]; ++j) {
+				acc += weights[j] * cage[indices[j]];
+			}
+			out[i] = acc;
+		}
+	});
+}
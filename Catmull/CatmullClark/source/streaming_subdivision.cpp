@@ -0,0 +1,159 @@
+#include "streaming_subdivision.h"
+
+// C std
+#include <climits>
+#include <cstdio>
+#include <cstring>
+
+// C++ std
+#include <algorithm>
+
+#include "spatial_order.h"
+#include "tiled_subdivision.h"
+#include "topology.h"
+
+const char STREAM_MAGIC[8] = { 'C', 'C', 'S', 'T', 'R', 'E', 'A', 'M' };
+
+size_t pointsOffset(const StreamedHeader &header) {
+	return sizeof(StreamedHeader) + sizeof(int) * size_t(header.cageFaceCount);
+}
+
+size_t quadsOffset(const StreamedHeader &header) {
+	return pointsOffset(header) + sizeof(Vec3) * size_t(header.vertCount);
+}
+
+/*
+============================================================================================
+ Reading
+============================================================================================
+*/
+bool StreamedMesh::open(const char *path) {
+	if (!file.open(path)) {
+		return false;
+	}
+
+	if (file.size < sizeof(StreamedHeader)) {
+		fprintf(stderr, "StreamedMesh: %s is too small\n", path);
+		file.close();
+		return false;
+	}
+
+	memcpy(&header, file.data, sizeof(StreamedHeader));
+	if (memcmp(header.magic, STREAM_MAGIC, sizeof(STREAM_MAGIC)) != 0 ||
+		quadsOffset(header) + sizeof(Vec4i) * size_t(header.quadCount) > file.size) {
+		fprintf(stderr, "StreamedMesh: %s is not a streamed level\n", path);
+		file.close();
+		return false;
+	}
+	return true;
+}
+
+const int* StreamedMesh::faceOrder() const {
+	return (const int*)(file.data + sizeof(StreamedHeader));
+}
+
+const Vec3* StreamedMesh::points() const {
+	return (const Vec3*)(file.data + pointsOffset(header));
+}
+
+const Vec4i* StreamedMesh::quads() const {
+	return (const Vec4i*)(file.data + quadsOffset(header));
+}
+
+/*
+============================================================================================
+ Streaming
+============================================================================================
+*/
+StreamingSubdivision::~StreamingSubdivision() {
+	cancel();
+	wait();
+}
+
+void StreamingSubdivision::start() {
+	worker = std::thread(&StreamingSubdivision::run, this);
+}
+
+void StreamingSubdivision::wait() {
+	if (worker.joinable()) {
+		worker.join();
+	}
+}
+
+float StreamingSubdivision::progress() const {
+	return chunkCount ? chunksDone / float(chunkCount) : 0.f;
+}
+
+bool StreamingSubdivision::run() {
+	succeeded = false;
+	const int faceCount = int(cageFaces.size());
+	if (level < 1 || level > 15 || faceCount == 0) {
+		fprintf(stderr, "StreamingSubdivision: nothing to do for level %d and %d faces\n", level, faceCount);
+		finished = true;
+		return false;
+	}
+
+	Topology cage;
+	buildTopology(cageFaces, cagePs.size(), cage);
+
+	// Chunks are consecutive in the file, so that the pages of a finished one can be released
+	const Vec<int> order = mortonOrder(cagePs, cageFaces);
+	Vec<int> slots(faceCount);
+	for (int s = 0; s < faceCount; ++s) {
+		slots[order[s]] = s;
+	}
+	CageGrid grid;
+	grid.init(cageFaces, cage, slots, level);
+
+	const long long n = grid.n;
+	StreamedHeader header;
+	memcpy(header.magic, STREAM_MAGIC, sizeof(STREAM_MAGIC));
+	header.level = level;
+	header.cageFaceCount = faceCount;
+	header.vertCount = grid.vertCount();
+	header.quadCount = grid.quadCount();
+	if (header.vertCount > INT_MAX) {
+		fprintf(stderr, "StreamingSubdivision: %lld vertices do not fit in 32 bit indices\n", header.vertCount);
+		finished = true;
+		return false;
+	}
+
+	MappedFile file;
+	if (!file.create(path.c_str(), quadsOffset(header) + sizeof(Vec4i) * size_t(header.quadCount))) {
+		finished = true;
+		return false;
+	}
+	memcpy(file.data + sizeof(header), order.data(), sizeof(int) * order.size());
+	Vec3 *points = (Vec3*)(file.data + pointsOffset(header));
+	Vec4i *quads = (Vec4i*)(file.data + quadsOffset(header));
+
+	const int chunkFaces = tileFaceCount(faceCount, level, workingSet);
+	chunkCount = (faceCount + chunkFaces - 1) / chunkFaces;
+	for (int c = 0; c < chunkCount && !cancelled; ++c) {
+		const int first = c * chunkFaces;
+		const int count = Min(chunkFaces, faceCount - first);
+
+		AdaptiveLevel chunk;
+		refineTile(cagePs, cageFaces, cage, &order[first], count, level, chunk);
+		writeTile(chunk, grid, points, quads);
+
+		// The quads and inner points of the chunk are contiguous and done with
+		const size_t quadBlock = sizeof(Vec4i) * size_t(n * n);
+		const size_t innerBlock = sizeof(Vec3) * size_t((n - 1) * (n - 1));
+		file.release(quadsOffset(header) + quadBlock * first, quadBlock * count);
+		file.release(pointsOffset(header) + sizeof(Vec3) * size_t(grid.faceBase) + innerBlock * first, innerBlock * count);
+		++chunksDone;
+	}
+
+	// The header goes in last, a cancelled file is not mistaken for a complete one
+	succeeded = !cancelled;
+	if (succeeded) {
+		memcpy(file.data, &header, sizeof(header));
+		if (!exportPath.empty()) {
+			succeeded = exportMapped(exportPath.c_str(), exportFormatOf(exportPath.c_str()), level, file, points,
+				header.vertCount, quads, header.quadCount, &exportStats);
+		}
+	}
+	finished = true;
+	return succeeded;
+}
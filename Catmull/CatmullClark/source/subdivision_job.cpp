@@ -0,0 +1,210 @@
+#include "subdivision_job.h"
+
+#include "limit_surface.h"
+#include "spatial_order.h"
+#include "subdivision_kernels.h"
+#include "tiled_subdivision.h"
+
+const Phase UNIFORM_STAGES[] = {
+	PhaseTopology, PhaseFacePoints, PhaseEdgePoints, PhaseVertexPoints, PhaseRefinement, PhaseReordering, PhaseLimit, PhaseTriangulation
+};
+const Phase TILED_STAGES[] = {
+	PhaseTiles, PhaseLimit, PhaseTriangulation
+};
+const Phase ADAPTIVE_STAGES[] = {
+	PhaseAdaptive, PhaseTessellation, PhaseTriangulation
+};
+
+template <class T, int N>
+int countOf(T (&)[N]) {
+	return N;
+}
+
+SubdivisionJob::~SubdivisionJob() {
+	cancel();
+	wait();
+}
+
+void SubdivisionJob::run() {
+	PROFILE(profile.level = level);
+	if (adaptive) {
+		runAdaptive();
+	} else if (engine == SubdivisionEngine::Tiled) {
+		runTiled();
+	} else {
+		runUniform();
+	}
+	PROFILE(phaseTimer.close(profile, heldBytes()));
+	finished = true;
+}
+
+void SubdivisionJob::start() {
+	worker = std::thread(&SubdivisionJob::run, this);
+}
+
+void SubdivisionJob::wait() {
+	if (worker.joinable()) {
+		worker.join();
+	}
+}
+
+int SubdivisionJob::stageCount() const {
+	if (adaptive) {
+		return countOf(ADAPTIVE_STAGES);
+	}
+	return engine == SubdivisionEngine::Tiled ? countOf(TILED_STAGES) : countOf(UNIFORM_STAGES);
+}
+
+const char* SubdivisionJob::stageName() const {
+	return phaseName(phaseOf(stage));
+}
+
+Phase SubdivisionJob::phaseOf(int s) const {
+	if (adaptive) {
+		return ADAPTIVE_STAGES[s];
+	}
+	return engine == SubdivisionEngine::Tiled ? TILED_STAGES[s] : UNIFORM_STAGES[s];
+}
+
+size_t SubdivisionJob::heldBytes() const {
+	return bytesOf(newPs) + bytesOf(newFaces) + bytesOf(triFaces) + topology.bytes() + newTopology.bytes() +
+		bytesOf(limitPs) + bytesOf(normals) + bytesOf(vertOrder) + grid.bytes() +
+		bytesOf(scratch.oldPs.x) * 3 + bytesOf(scratch.outPs.x) * 3;
+}
+
+float SubdivisionJob::progress() const {
+	return finished ? 1.f : stage / float(stageCount());
+}
+
+// Moves on to stage s, false if the job was cancelled meanwhile
+bool SubdivisionJob::enter(int s) {
+	PROFILE(phaseTimer.open(profile, phaseOf(s), heldBytes()));
+	stage = s;
+	return !cancelled;
+}
+
+// See the point ordering in mesh.cpp
+void SubdivisionJob::runUniform() {
+	if (!enter(0)) {
+		return;
+	}
+	// With a shared refinement the parent level comes from there, refined by the first mesh that needed it
+	const TopologyLevel *shared = refinement ? &refinement->level(level - 1) : nullptr;
+	const Vec<Vec4i> &parentFaces = shared ? shared->faces : faces;
+	const Topology &parent = shared ? shared->topology : topology;
+	if (!shared && !topology.matches(faces)) {
+		buildTopology(faces, ps.size(), topology);
+	}
+	PROFILE(profile.count(PhaseTopology, (long long)parentFaces.size()));
+
+	if (!enter(1)) {
+		return;
+	}
+	PointsSoA &oldPs = scratch.oldPs, &outPs = scratch.outPs;
+	oldPs.fromAoS(ps);
+	outPs.resize(parent.vertCount + parent.faceCount() + parent.edgeCount());
+	findFacePoints(parentFaces, oldPs, outPs);
+	PROFILE(profile.count(PhaseFacePoints, parent.faceCount()));
+
+	if (!enter(2)) {
+		return;
+	}
+	findEdgePoints(parent, oldPs, outPs);
+	PROFILE(profile.count(PhaseEdgePoints, parent.edgeCount()));
+
+	if (!enter(3)) {
+		return;
+	}
+	updatePoints(parent, oldPs, outPs);
+	outPs.toAoS(newPs);
+	PROFILE(profile.count(PhaseVertexPoints, parent.vertCount));
+
+	if (!enter(4)) {
+		return;
+	}
+	if (shared) {
+		// Nothing is copied, the level refers to its connectivity in the refinement
+		const TopologyLevel &child = refinement->level(level);
+		sharedLevel = std::shared_ptr<const TopologyLevel>(refinement, &child);
+		PROFILE(profile.count(PhaseRefinement, (long long)child.faces.size()));
+		if (limitProjection) {
+			limitProject(child.faces, child.topology, newPs, limitPs, normals);
+		}
+		return;
+	}
+	refineTopology(faces, topology, newFaces, newTopology);
+	PROFILE(profile.count(PhaseRefinement, (long long)newFaces.size()));
+
+	if (!enter(5)) {
+		return;
+	}
+	if (spatialOrder) {
+		::spatialOrder(newPs, vertOrder);
+		reorderVertices(vertOrder, newPs, newFaces, newTopology);
+		PROFILE(profile.count(PhaseReordering, (long long)newPs.size()));
+	}
+
+	if (!enter(6)) {
+		return;
+	}
+	if (limitProjection) {
+		limitProject(newFaces, newTopology, newPs, limitPs, normals);
+		PROFILE(profile.count(PhaseLimit, (long long)newPs.size()));
+	}
+
+	if (!enter(7)) {
+		return;
+	}
+	triangulate(newFaces, triFaces);
+	PROFILE(profile.count(PhaseTriangulation, (long long)newFaces.size()));
+}
+
+// Straight from the cage, the topology is only built when the limit needs it
+void SubdivisionJob::runTiled() {
+	if (!enter(0)) {
+		return;
+	}
+	if (gridStorage) {
+		tiledPoints(cagePs, cageFaces, level, newPs);
+		grid.init(cageFaces, cagePs.size(), level);
+		PROFILE(profile.count(PhaseTiles, (long long)newPs.size()));
+		return;
+	}
+	tiledSubdivide(cagePs, cageFaces, level, newPs, newFaces);
+	PROFILE(profile.count(PhaseTiles, (long long)newPs.size()));
+
+	if (!enter(1)) {
+		return;
+	}
+	if (limitProjection) {
+		buildTopology(newFaces, newPs.size(), newTopology);
+		limitProject(newFaces, newTopology, newPs, limitPs, normals);
+		PROFILE(profile.count(PhaseLimit, (long long)newPs.size()));
+	}
+
+	if (!enter(2)) {
+		return;
+	}
+	triangulate(newFaces, triFaces);
+	PROFILE(profile.count(PhaseTriangulation, (long long)newFaces.size()));
+}
+
+void SubdivisionJob::runAdaptive() {
+	if (!enter(0)) {
+		return;
+	}
+	adaptiveMesh.build(cagePs, cageFaces, level);
+	PROFILE(profile.count(PhaseAdaptive, (long long)cageFaces.size()));
+
+	if (!enter(1)) {
+		return;
+	}
+	adaptiveMesh.tessellate(patchRate, newPs, normals, newFaces);
+	PROFILE(profile.count(PhaseTessellation, (long long)newFaces.size()));
+
+	if (!enter(2)) {
+		return;
+	}
+	triangulate(newFaces, triFaces);
+	PROFILE(profile.count(PhaseTriangulation, (long long)newFaces.size()));
+}
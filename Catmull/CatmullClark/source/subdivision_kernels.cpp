@@ -0,0 +1,609 @@
+#include "subdivision_kernels.h"
+
+// C++ std
+#include <algorithm>
+
+#include "mesh.h"
+#include "parallel.h"
+#include "simd.h"
+
+/*
+============================================================================================
+ Layout
+============================================================================================
+*/
+void PointsSoA::resize(int n) {
+	resizeExact(x, n);
+	resizeExact(y, n);
+	resizeExact(z, n);
+}
+
+void PointsSoA::fromAoS(const Vec<Vec3> &ps) {
+	resize(ps.size());
+	parallelFor(ps.size(), [&](int begin, int end) {
+		for (int i = begin; i < end; ++i) {
+			set(i, ps[i]);
+		}
+	});
+}
+
+void PointsSoA::toAoS(Vec<Vec3> &ps) const {
+	resizeExact(ps, size());
+	parallelFor(size(), [&](int begin, int end) {
+		for (int i = begin; i < end; ++i) {
+			ps[i] = get(i);
+		}
+	});
+}
+
+/*
+============================================================================================
+ Dispatch
+============================================================================================
+*/
+bool cpuHasAVX2() {
+#if !defined(SIMD_X64)
+	return false;
+#elif defined(_MSC_VER)
+	int regs[4];
+	__cpuid(regs, 0);
+	if (regs[0] < 7) {
+		return false;
+	}
+	__cpuidex(regs, 7, 0);
+	const bool avx2 = (regs[1] & (1 << 5)) != 0;
+	__cpuid(regs, 1);
+	const bool osSavesYmm = (regs[2] & (1 << 27)) != 0 && (_xgetbv(0) & 6) == 6;
+	return avx2 && osSavesYmm;
+#else
+	return __builtin_cpu_supports("avx2");
+#endif
+}
+
+SimdPath bestSimdPath() {
+#ifdef SIMD_X64
+	return cpuHasAVX2() ? SimdPath::AVX2 : SimdPath::SSE; // SSE2 is part of x64
+#else
+	return SimdPath::Scalar;
+#endif
+}
+
+SimdPath currentPath = bestSimdPath();
+
+SimdPath simdPath() {
+	return currentPath;
+}
+
+void setSimdPath(SimdPath path) {
+	currentPath = Min(path, bestSimdPath());
+}
+
+const char* simdPathName(SimdPath path) {
+	switch (path) {
+	case SimdPath::AVX2: return "AVX2";
+	case SimdPath::SSE: return "SSE";
+	default: return "scalar";
+	}
+}
+
+/*
+============================================================================================
+ Scalar rules. The reference for the vectorized versions.
+============================================================================================
+*/
+void facePointScalar(const Vec<Vec4i> &faces, const PointsSoA &ps, PointsSoA &out, int f) {
+	const auto &face = faces[f];
+
+	Vec3 facePoint{ 0.f, 0.f, 0.f };
+	for (int j = 0; j < Mesh::QUAD_FACE_VERTS; ++j) {
+		facePoint += ps.get(face[j]);
+	}
+	out.set(ps.size() + f, facePoint * 0.25f);
+}
+
+void edgePointScalar(const Topology &topology, const PointsSoA &ps, PointsSoA &out, int e) {
+	const int n = ps.size();
+	const int m = topology.faceCount();
+	const auto edge = topology.edgeVerts[e];
+
+	// Find the middle point of the edge and average it with the average of the neigbouring faces' face points.
+	const Vec3 edgeMiddle = (ps.get(edge[0]) + ps.get(edge[1])) * 0.5f;
+	const int f1 = topology.edgeFaces[e].x;
+	const int f2 = topology.edgeFaces[e].y;
+
+	// If edge is on a border of a hole we use the middle point as an edge point
+	if (f1 == -1 || f2 == -1) {
+		out.set(n + m + e, edgeMiddle);
+		return;
+	}
+
+	const Vec3 facesMiddle = (out.get(n + f1) + out.get(n + f2)) * 0.5f;
+	out.set(n + m + e, (edgeMiddle + facesMiddle) * 0.5f);
+}
+
+void vertexPointScalar(const Topology &topology, const PointsSoA &ps, PointsSoA &out, int i) {
+	const int n = ps.size();
+	const auto &edges = topology.edgeVerts;
+
+	const int eBegin = topology.vertEdgeOffsets[i];
+	const int eEnd = topology.vertEdgeOffsets[i + 1];
+	const int fBegin = topology.vertFaceOffsets[i];
+	const int fEnd = topology.vertFaceOffsets[i + 1];
+	const Vec3 p = ps.get(i);
+
+	if (fBegin == fEnd) { // isolated vertex
+		out.set(i, p);
+		return;
+	}
+
+	if (!topology.isBoundaryVert(i)) {
+		Vec3 avgFacesPoint{ 0.f, 0.f, 0.f };
+		for (int j = fBegin; j < fEnd; ++j) {
+			avgFacesPoint += out.get(n + topology.vertFaces[j]);
+		}
+		avgFacesPoint /= float(fEnd - fBegin);
+
+		Vec3 avgEdgesPoint{ 0.f, 0.f, 0.f };
+		for (int j = eBegin; j < eEnd; ++j) {
+			const auto &edge = edges[topology.vertEdges[j]];
+			avgEdgesPoint += (ps.get(edge[0]) + ps.get(edge[1])) * 0.5f;
+		}
+		avgEdgesPoint /= float(eEnd - eBegin);
+
+		const int valence = eEnd - eBegin;
+		out.set(i, (p * float(valence - 3) + avgFacesPoint + 2.f * avgEdgesPoint) / float(valence));
+	} else { // vertex is on the border of a hole
+		int cnt = 0;
+		Vec3 newPoint = p;
+		for (int j = eBegin; j < eEnd; ++j) {
+			const int e = topology.vertEdges[j];
+			if (!topology.isBoundaryEdge(e)) {
+				continue;
+			}
+			newPoint += (ps.get(edges[e][0]) + ps.get(edges[e][1])) * 0.5f;
+			++cnt;
+		}
+		out.set(i, newPoint / float(cnt + 1));
+	}
+}
+
+/*
+============================================================================================
+ Vertex classes. The vertex rule with the valence as a template argument, so the loops are
+ unrolled and the weights constant. Same operations in the same order as vertexPointScalar.
+============================================================================================
+*/
+// Interior vertex of valence N
+template <int N>
+void interiorPoints(const Topology &topology, const PointsSoA &ps, PointsSoA &out, int begin, int end) {
+	constexpr float VALENCE = float(N);
+	constexpr float SELF = float(N - 3);
+	const int n = ps.size();
+	const Vec2i *edges = topology.edgeVerts.data();
+	for (int i = begin; i < end; ++i) {
+		const int *vertEdges = &topology.vertEdges[topology.vertEdgeOffsets[i]];
+		const int *vertFaces = &topology.vertFaces[topology.vertFaceOffsets[i]];
+		const Vec3 p = ps.get(i);
+
+		Vec3 avgFacesPoint{ 0.f, 0.f, 0.f };
+		for (int j = 0; j < N; ++j) {
+			avgFacesPoint += out.get(n + vertFaces[j]);
+		}
+		avgFacesPoint /= VALENCE;
+
+		Vec3 avgEdgesPoint{ 0.f, 0.f, 0.f };
+		for (int j = 0; j < N; ++j) {
+			const Vec2i &edge = edges[vertEdges[j]];
+			avgEdgesPoint += (ps.get(edge[0]) + ps.get(edge[1])) * 0.5f;
+		}
+		avgEdgesPoint /= VALENCE;
+
+		out.set(i, (p * SELF + avgFacesPoint + 2.f * avgEdgesPoint) / VALENCE);
+	}
+}
+
+// Border vertex with N edges of which exactly 2 are on the border, taken in edge order
+template <int N>
+void borderPoints(const Topology &topology, const PointsSoA &ps, PointsSoA &out, int begin, int end) {
+	const Vec2i *edges = topology.edgeVerts.data();
+	for (int i = begin; i < end; ++i) {
+		const int *vertEdges = &topology.vertEdges[topology.vertEdgeOffsets[i]];
+		int first = vertEdges[0], second = vertEdges[1];
+		if (N == 3) {
+			// The inner edge is one of the three, the selects compile to conditional moves
+			first = topology.isBoundaryEdge(vertEdges[0]) ? vertEdges[0] : vertEdges[1];
+			second = topology.isBoundaryEdge(vertEdges[2]) ? vertEdges[2] : vertEdges[1];
+		}
+
+		Vec3 newPoint = ps.get(i);
+		newPoint += (ps.get(edges[first][0]) + ps.get(edges[first][1])) * 0.5f;
+		newPoint += (ps.get(edges[second][0]) + ps.get(edges[second][1])) * 0.5f;
+		out.set(i, newPoint / 3.f);
+	}
+}
+
+#ifdef SIMD_X64
+/*
+============================================================================================
+ SSE. 4 elements per iteration, gathers done lane by lane.
+============================================================================================
+*/
+struct SSEPoints {
+	__m128 x, y, z;
+};
+
+inline SSEPoints gatherSSE(const PointsSoA &ps, const int idx[4]) {
+	return {
+		_mm_setr_ps(ps.x[idx[0]], ps.x[idx[1]], ps.x[idx[2]], ps.x[idx[3]]),
+		_mm_setr_ps(ps.y[idx[0]], ps.y[idx[1]], ps.y[idx[2]], ps.y[idx[3]]),
+		_mm_setr_ps(ps.z[idx[0]], ps.z[idx[1]], ps.z[idx[2]], ps.z[idx[3]]),
+	};
+}
+
+inline SSEPoints addSSE(const SSEPoints &a, const SSEPoints &b) {
+	return { _mm_add_ps(a.x, b.x), _mm_add_ps(a.y, b.y), _mm_add_ps(a.z, b.z) };
+}
+
+inline SSEPoints mulSSE(const SSEPoints &a, float s) {
+	const __m128 v = _mm_set1_ps(s);
+	return { _mm_mul_ps(a.x, v), _mm_mul_ps(a.y, v), _mm_mul_ps(a.z, v) };
+}
+
+inline void storeSSE(PointsSoA &out, int i, const SSEPoints &p) {
+	_mm_storeu_ps(&out.x[i], p.x);
+	_mm_storeu_ps(&out.y[i], p.y);
+	_mm_storeu_ps(&out.z[i], p.z);
+}
+
+void facePointsSSE(const Vec<Vec4i> &faces, const PointsSoA &ps, PointsSoA &out, int begin, int end) {
+	const int n = ps.size();
+	int f = begin;
+	for (; f + 4 <= end; f += 4) {
+		SSEPoints acc = { _mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps() };
+		for (int j = 0; j < Mesh::QUAD_FACE_VERTS; ++j) {
+			const int idx[4] = { faces[f][j], faces[f + 1][j], faces[f + 2][j], faces[f + 3][j] };
+			acc = addSSE(acc, gatherSSE(ps, idx));
+		}
+		storeSSE(out, n + f, mulSSE(acc, 0.25f));
+	}
+	for (; f < end; ++f) {
+		facePointScalar(faces, ps, out, f);
+	}
+}
+
+void edgePointsSSE(const Topology &topology, const PointsSoA &ps, PointsSoA &out, int begin, int end) {
+	const int n = ps.size();
+	const int m = topology.faceCount();
+	int e = begin;
+	for (; e + 4 <= end; e += 4) {
+		int v0[4], v1[4], f1[4], f2[4];
+		int boundary[4];
+		for (int l = 0; l < 4; ++l) {
+			v0[l] = topology.edgeVerts[e + l].x;
+			v1[l] = topology.edgeVerts[e + l].y;
+			boundary[l] = (topology.edgeFaces[e + l].x == -1 || topology.edgeFaces[e + l].y == -1) ? -1 : 0;
+			f1[l] = n + Max(topology.edgeFaces[e + l].x, 0);
+			f2[l] = n + Max(topology.edgeFaces[e + l].y, 0);
+		}
+
+		const SSEPoints mid = mulSSE(addSSE(gatherSSE(ps, v0), gatherSSE(ps, v1)), 0.5f);
+		const SSEPoints facesMid = mulSSE(addSSE(gatherSSE(out, f1), gatherSSE(out, f2)), 0.5f);
+		const SSEPoints inner = mulSSE(addSSE(mid, facesMid), 0.5f);
+
+		const __m128 mask = _mm_castsi128_ps(_mm_loadu_si128((const __m128i*)boundary));
+		auto select = [&mask](__m128 a, __m128 b) { // mask ? a : b
+			return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+		};
+		storeSSE(out, n + m + e, { select(mid.x, inner.x), select(mid.y, inner.y), select(mid.z, inner.z) });
+	}
+	for (; e < end; ++e) {
+		edgePointScalar(topology, ps, out, e);
+	}
+}
+
+// Interior valence 4 vertices [v, v + 4)
+inline void interior4SSE(const Topology &topology, const PointsSoA &ps, PointsSoA &out, int v) {
+	const int n = ps.size();
+	const auto &edges = topology.edgeVerts;
+	const SSEPoints p = { _mm_loadu_ps(&ps.x[v]), _mm_loadu_ps(&ps.y[v]), _mm_loadu_ps(&ps.z[v]) };
+	const __m128 zero = _mm_setzero_ps();
+	SSEPoints sumFaces = { zero, zero, zero };
+	SSEPoints sumEdges = { zero, zero, zero };
+	for (int k = 0; k < 4; ++k) {
+		int other[4], face[4];
+		for (int l = 0; l < 4; ++l) {
+			const Vec2i &edge = edges[topology.vertEdges[topology.vertEdgeOffsets[v + l] + k]];
+			other[l] = edge.x + edge.y - (v + l);
+			face[l] = n + topology.vertFaces[topology.vertFaceOffsets[v + l] + k];
+		}
+		sumFaces = addSSE(sumFaces, gatherSSE(out, face));
+		sumEdges = addSSE(sumEdges, mulSSE(addSSE(p, gatherSSE(ps, other)), 0.5f));
+	}
+
+	// (P * (4 - 3) + avgFaces + 2 * avgEdges) / 4
+	const SSEPoints avgFaces = mulSSE(sumFaces, 0.25f);
+	const SSEPoints avgEdges = mulSSE(sumEdges, 0.25f);
+	storeSSE(out, v, mulSSE(addSSE(addSSE(p, avgFaces), mulSSE(avgEdges, 2.f)), 0.25f));
+}
+
+void vertexPointsSSE(const Topology &topology, const PointsSoA &ps, PointsSoA &out, int begin, int end) {
+	int v = begin;
+	while (v + 4 <= end) {
+		bool regular = true;
+		for (int l = 0; l < 4; ++l) {
+			regular &= topology.isRegularVert(v + l); // regular vertices take the vectorized path
+		}
+		if (!regular) {
+			vertexPointScalar(topology, ps, out, v++);
+			continue;
+		}
+		interior4SSE(topology, ps, out, v);
+		v += 4;
+	}
+	for (; v < end; ++v) {
+		vertexPointScalar(topology, ps, out, v);
+	}
+}
+
+// Run of Interior4 vertices, vertexPointsSSE without the check
+void interior4PointsSSE(const Topology &topology, const PointsSoA &ps, PointsSoA &out, int begin, int end) {
+	int v = begin;
+	for (; v + 4 <= end; v += 4) {
+		interior4SSE(topology, ps, out, v);
+	}
+	interiorPoints<4>(topology, ps, out, v, end);
+}
+
+/*
+============================================================================================
+ AVX2. 8 elements per iteration with hardware gathers.
+============================================================================================
+*/
+struct AVXPoints {
+	__m256 x, y, z;
+};
+
+TARGET_AVX2 inline AVXPoints gatherAVX(const PointsSoA &ps, __m256i idx) {
+	return {
+		_mm256_i32gather_ps(ps.x.data(), idx, 4),
+		_mm256_i32gather_ps(ps.y.data(), idx, 4),
+		_mm256_i32gather_ps(ps.z.data(), idx, 4),
+	};
+}
+
+TARGET_AVX2 inline AVXPoints addAVX(const AVXPoints &a, const AVXPoints &b) {
+	return { _mm256_add_ps(a.x, b.x), _mm256_add_ps(a.y, b.y), _mm256_add_ps(a.z, b.z) };
+}
+
+TARGET_AVX2 inline AVXPoints mulAVX(const AVXPoints &a, float s) {
+	const __m256 v = _mm256_set1_ps(s);
+	return { _mm256_mul_ps(a.x, v), _mm256_mul_ps(a.y, v), _mm256_mul_ps(a.z, v) };
+}
+
+TARGET_AVX2 inline void storeAVX(PointsSoA &out, int i, const AVXPoints &p) {
+	_mm256_storeu_ps(&out.x[i], p.x);
+	_mm256_storeu_ps(&out.y[i], p.y);
+	_mm256_storeu_ps(&out.z[i], p.z);
+}
+
+TARGET_AVX2 void facePointsAVX2(const Vec<Vec4i> &faces, const PointsSoA &ps, PointsSoA &out, int begin, int end) {
+	const int n = ps.size();
+	const int *faceVerts = (const int*)faces.data();
+	const __m256i lanes = _mm256_setr_epi32(0, 4, 8, 12, 16, 20, 24, 28);
+	int f = begin;
+	for (; f + 8 <= end; f += 8) {
+		const __m256i base = _mm256_add_epi32(lanes, _mm256_set1_epi32(4 * f));
+		const __m256 zero = _mm256_setzero_ps();
+		AVXPoints acc = { zero, zero, zero };
+		for (int j = 0; j < Mesh::QUAD_FACE_VERTS; ++j) {
+			const __m256i idx = _mm256_i32gather_epi32(faceVerts, _mm256_add_epi32(base, _mm256_set1_epi32(j)), 4);
+			acc = addAVX(acc, gatherAVX(ps, idx));
+		}
+		storeAVX(out, n + f, mulAVX(acc, 0.25f));
+	}
+	for (; f < end; ++f) {
+		facePointScalar(faces, ps, out, f);
+	}
+}
+
+TARGET_AVX2 void edgePointsAVX2(const Topology &topology, const PointsSoA &ps, PointsSoA &out, int begin, int end) {
+	const int n = ps.size();
+	const int m = topology.faceCount();
+	const int *edgeVerts = (const int*)topology.edgeVerts.data();
+	const int *edgeFaces = (const int*)topology.edgeFaces.data();
+	const __m256i lanes = _mm256_setr_epi32(0, 2, 4, 6, 8, 10, 12, 14);
+	const __m256i one = _mm256_set1_epi32(1);
+	const __m256i none = _mm256_set1_epi32(-1);
+	const __m256i facePointBase = _mm256_set1_epi32(n);
+	int e = begin;
+	for (; e + 8 <= end; e += 8) {
+		const __m256i idx0 = _mm256_add_epi32(lanes, _mm256_set1_epi32(2 * e));
+		const __m256i idx1 = _mm256_add_epi32(idx0, one);
+		const __m256i v0 = _mm256_i32gather_epi32(edgeVerts, idx0, 4);
+		const __m256i v1 = _mm256_i32gather_epi32(edgeVerts, idx1, 4);
+		const __m256i f1 = _mm256_i32gather_epi32(edgeFaces, idx0, 4);
+		const __m256i f2 = _mm256_i32gather_epi32(edgeFaces, idx1, 4);
+		const __m256 boundary = _mm256_castsi256_ps(_mm256_or_si256(_mm256_cmpeq_epi32(f1, none), _mm256_cmpeq_epi32(f2, none)));
+
+		// Boundary lanes gather face point 0 and throw it away
+		const __m256i fp1 = _mm256_add_epi32(_mm256_max_epi32(f1, _mm256_setzero_si256()), facePointBase);
+		const __m256i fp2 = _mm256_add_epi32(_mm256_max_epi32(f2, _mm256_setzero_si256()), facePointBase);
+
+		const AVXPoints mid = mulAVX(addAVX(gatherAVX(ps, v0), gatherAVX(ps, v1)), 0.5f);
+		const AVXPoints facesMid = mulAVX(addAVX(gatherAVX(out, fp1), gatherAVX(out, fp2)), 0.5f);
+		const AVXPoints inner = mulAVX(addAVX(mid, facesMid), 0.5f);
+
+		storeAVX(out, n + m + e, {
+			_mm256_blendv_ps(inner.x, mid.x, boundary),
+			_mm256_blendv_ps(inner.y, mid.y, boundary),
+			_mm256_blendv_ps(inner.z, mid.z, boundary),
+		});
+	}
+	for (; e < end; ++e) {
+		edgePointScalar(topology, ps, out, e);
+	}
+}
+
+// Interior valence 4 vertices [v, v + 8)
+TARGET_AVX2 inline void interior4AVX2(const Topology &topology, const PointsSoA &ps, PointsSoA &out, int v) {
+	const int *vertEdges = topology.vertEdges.data();
+	const int *vertFaces = topology.vertFaces.data();
+	const int *edgeVerts = (const int*)topology.edgeVerts.data();
+	const __m256i eo = _mm256_loadu_si256((const __m256i*)(topology.vertEdgeOffsets.data() + v));
+	const __m256i fo = _mm256_loadu_si256((const __m256i*)(topology.vertFaceOffsets.data() + v));
+	const __m256i self = _mm256_add_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(v));
+	const __m256i facePointBase = _mm256_set1_epi32(ps.size());
+
+	const AVXPoints p = { _mm256_loadu_ps(&ps.x[v]), _mm256_loadu_ps(&ps.y[v]), _mm256_loadu_ps(&ps.z[v]) };
+	const __m256 zero = _mm256_setzero_ps();
+	AVXPoints sumFaces = { zero, zero, zero };
+	AVXPoints sumEdges = { zero, zero, zero };
+	for (int k = 0; k < 4; ++k) {
+		const __m256i kk = _mm256_set1_epi32(k);
+		const __m256i e2 = _mm256_slli_epi32(_mm256_i32gather_epi32(vertEdges, _mm256_add_epi32(eo, kk), 4), 1);
+		const __m256i a = _mm256_i32gather_epi32(edgeVerts, e2, 4);
+		const __m256i b = _mm256_i32gather_epi32(edgeVerts, _mm256_add_epi32(e2, _mm256_set1_epi32(1)), 4);
+		const __m256i other = _mm256_sub_epi32(_mm256_add_epi32(a, b), self);
+		const __m256i face = _mm256_add_epi32(_mm256_i32gather_epi32(vertFaces, _mm256_add_epi32(fo, kk), 4), facePointBase);
+
+		sumFaces = addAVX(sumFaces, gatherAVX(out, face));
+		sumEdges = addAVX(sumEdges, mulAVX(addAVX(p, gatherAVX(ps, other)), 0.5f));
+	}
+
+	// (P * (4 - 3) + avgFaces + 2 * avgEdges) / 4
+	const AVXPoints avgFaces = mulAVX(sumFaces, 0.25f);
+	const AVXPoints avgEdges = mulAVX(sumEdges, 0.25f);
+	storeAVX(out, v, mulAVX(addAVX(addAVX(p, avgFaces), mulAVX(avgEdges, 2.f)), 0.25f));
+}
+
+TARGET_AVX2 void vertexPointsAVX2(const Topology &topology, const PointsSoA &ps, PointsSoA &out, int begin, int end) {
+	const int *eOff = topology.vertEdgeOffsets.data();
+	const int *fOff = topology.vertFaceOffsets.data();
+	const __m256i four = _mm256_set1_epi32(4);
+
+	int v = begin;
+	while (v + 8 <= end) {
+		const __m256i eo = _mm256_loadu_si256((const __m256i*)(eOff + v));
+		const __m256i fo = _mm256_loadu_si256((const __m256i*)(fOff + v));
+		const __m256i eCount = _mm256_sub_epi32(_mm256_loadu_si256((const __m256i*)(eOff + v + 1)), eo);
+		const __m256i fCount = _mm256_sub_epi32(_mm256_loadu_si256((const __m256i*)(fOff + v + 1)), fo);
+		const __m256i regular = _mm256_and_si256(_mm256_cmpeq_epi32(eCount, four), _mm256_cmpeq_epi32(fCount, four));
+		if (_mm256_movemask_epi8(regular) != -1) {
+			vertexPointScalar(topology, ps, out, v++);
+			continue;
+		}
+		interior4AVX2(topology, ps, out, v);
+		v += 8;
+	}
+	for (; v < end; ++v) {
+		vertexPointScalar(topology, ps, out, v);
+	}
+}
+
+// Run of Interior4 vertices, vertexPointsAVX2 without the check
+TARGET_AVX2 void interior4PointsAVX2(const Topology &topology, const PointsSoA &ps, PointsSoA &out, int begin, int end) {
+	int v = begin;
+	for (; v + 8 <= end; v += 8) {
+		interior4AVX2(topology, ps, out, v);
+	}
+	interiorPoints<4>(topology, ps, out, v, end);
+}
+#endif // SIMD_X64
+
+/*
+============================================================================================
+ Entry points
+============================================================================================
+*/
+void facePointsKernel(const Vec<Vec4i> &faces, const PointsSoA &ps, PointsSoA &out, int begin, int end) {
+#ifdef SIMD_X64
+	switch (currentPath) {
+	case SimdPath::AVX2: facePointsAVX2(faces, ps, out, begin, end); return;
+	case SimdPath::SSE: facePointsSSE(faces, ps, out, begin, end); return;
+	default: break;
+	}
+#endif
+	for (int f = begin; f < end; ++f) {
+		facePointScalar(faces, ps, out, f);
+	}
+}
+
+void edgePointsKernel(const Topology &topology, const PointsSoA &ps, PointsSoA &out, int begin, int end) {
+#ifdef SIMD_X64
+	switch (currentPath) {
+	case SimdPath::AVX2: edgePointsAVX2(topology, ps, out, begin, end); return;
+	case SimdPath::SSE: edgePointsSSE(topology, ps, out, begin, end); return;
+	default: break;
+	}
+#endif
+	for (int e = begin; e < end; ++e) {
+		edgePointScalar(topology, ps, out, e);
+	}
+}
+
+void vertexPointsKernel(const Topology &topology, const PointsSoA &ps, PointsSoA &out, int begin, int end) {
+#ifdef SIMD_X64
+	switch (currentPath) {
+	case SimdPath::AVX2: vertexPointsAVX2(topology, ps, out, begin, end); return;
+	case SimdPath::SSE: vertexPointsSSE(topology, ps, out, begin, end); return;
+	default: break;
+	}
+#endif
+	for (int v = begin; v < end; ++v) {
+		vertexPointScalar(topology, ps, out, v);
+	}
+}
+
+void vertexClassKernel(VertexClass c, const Topology &topology, const PointsSoA &ps, PointsSoA &out, int begin, int end) {
+	switch (c) {
+	case Interior3: interiorPoints<3>(topology, ps, out, begin, end); return;
+	case Interior4:
+#ifdef SIMD_X64
+		switch (currentPath) {
+		case SimdPath::AVX2: interior4PointsAVX2(topology, ps, out, begin, end); return;
+		case SimdPath::SSE: interior4PointsSSE(topology, ps, out, begin, end); return;
+		default: break;
+		}
+#endif
+		interiorPoints<4>(topology, ps, out, begin, end);
+		return;
+	case Interior5: interiorPoints<5>(topology, ps, out, begin, end); return;
+	case Interior6: interiorPoints<6>(topology, ps, out, begin, end); return;
+	case Corner: borderPoints<2>(topology, ps, out, begin, end); return;
+	case Border3: borderPoints<3>(topology, ps, out, begin, end); return;
+	default:
+		for (int v = begin; v < end; ++v) {
+			vertexPointScalar(topology, ps, out, v);
+		}
+		return;
+	}
+}
+
+void findFacePoints(const Vec<Vec4i> &faces, const PointsSoA &ps, PointsSoA &newPs) {
+	parallelFor(faces.size(), [&](int begin, int end) {
+		facePointsKernel(faces, ps, newPs, begin, end);
+	});
+}
+
+void findEdgePoints(const Topology &topology, const PointsSoA &ps, PointsSoA &newPs) {
+	parallelFor(topology.edgeCount(), [&](int begin, int end) {
+		edgePointsKernel(topology, ps, newPs, begin, end);
+	});
+}
+
+// Each range goes through the class kernels of the runs it overlaps
+void updatePoints(const Topology &topology, const PointsSoA &ps, PointsSoA &newPs) {
+	const Vec<VertexRun> &runs = topology.vertexRuns;
+	if (runs.empty()) {
+		parallelFor(ps.size(), [&](int begin, int end) {
+			vertexPointsKernel(topology, ps, newPs, begin, end);
+		});
+		return;
+	}
+	parallelFor(ps.size(), [&](int begin, int end) {
+		auto run = std::upper_bound(runs.begin(), runs.end(), begin, [](int v, const VertexRun &r) { return v < r.end; });
+		for (; run != runs.end() && run->begin < end; ++run) {
+			vertexClassKernel(run->vertexClass, topology, ps, newPs, Max(begin, run->begin), Min(end, run->end));
+		}
+	});
+}
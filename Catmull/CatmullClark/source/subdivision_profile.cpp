@@ -0,0 +1,103 @@
+#include "subdivision_profile.h"
+
+const char *PHASE_NAMES[] = {
+	"Topology", "Face points", "Edge points", "Vertex points", "Refinement", "Reordering",
+	"Limit surface", "Triangulation", "Tiles", "Adaptive refinement", "Tessellation", "Upload"
+};
+static_assert(sizeof(PHASE_NAMES) / sizeof(PHASE_NAMES[0]) == PHASE_COUNT, "A phase has no name");
+
+const char* phaseName(Phase phase) {
+	return PHASE_NAMES[phase];
+}
+
+double LevelProfile::ms() const {
+	double sum = 0.0;
+	for (const PhaseStats &stats : phases) {
+		sum += stats.ms;
+	}
+	return sum;
+}
+
+void PhaseTimer::open(LevelProfile &profile, Phase next, size_t held) {
+	close(profile, held);
+	phase = next;
+	heldBytes = held;
+	start = std::chrono::high_resolution_clock::now();
+}
+
+void PhaseTimer::close(LevelProfile &profile, size_t held) {
+	if (phase < 0) {
+		return;
+	}
+	PhaseStats &stats = profile.phases[phase];
+	stats.ms += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	++stats.calls;
+	if (held > heldBytes) {
+		stats.allocatedBytes += held - heldBytes;
+	}
+	phase = -1;
+}
+
+LevelProfile& SubdivisionProfile::at(int level) {
+	if (int(levels.size()) <= level) {
+		levels.resize(level + 1);
+	}
+	levels[level].level = level;
+	return levels[level];
+}
+
+void SubdivisionProfile::record(const LevelProfile &profile) {
+	if (profile.level >= 0) {
+		at(profile.level) = profile;
+	}
+}
+
+/*
+============================================================================================
+ JSON
+============================================================================================
+*/
+bool SubdivisionProfile::writeJson(const char *path) const {
+	FILE *out = fopen(path, "w");
+	if (!out) {
+		fprintf(stderr, "SubdivisionProfile: cannot write %s\n", path);
+		return false;
+	}
+	fprintf(out, "{\n");
+	fprintf(out, "  \"levels\": ");
+	writeJson(out, "  ");
+	fprintf(out, "\n}\n");
+	const bool ok = !ferror(out);
+	fclose(out);
+	if (!ok) {
+		fprintf(stderr, "SubdivisionProfile: cannot write %s\n", path);
+	}
+	return ok;
+}
+
+void SubdivisionProfile::writeJson(FILE *out, const char *indent) const {
+	fprintf(out, "[");
+	bool firstLevel = true;
+	for (const LevelProfile &level : levels) {
+		if (level.level < 0) {
+			continue;
+		}
+		fprintf(out, "%s\n%s  { \"level\": %d, \"ms\": %.3f, \"phases\": [", firstLevel ? "" : ",", indent, level.level, level.ms());
+		firstLevel = false;
+
+		bool firstPhase = true;
+		for (int p = 0; p < PHASE_COUNT; ++p) {
+			const PhaseStats &stats = level.phases[p];
+			if (!stats.calls) {
+				continue;
+			}
+			fprintf(out, "%s\n%s    { \"phase\": \"%s\", \"calls\": %d, \"ms\": %.3f, \"elements\": %lld, "
+				"\"allocatedBytes\": %zu, \"uploadedBytes\": %zu }",
+				firstPhase ? "" : ",", indent, phaseName(Phase(p)), stats.calls, stats.ms, stats.elements,
+				stats.allocatedBytes, stats.uploadedBytes);
+			firstPhase = false;
+		}
+		fprintf(out, "\n%s  ] }", indent);
+	}
+	fprintf(out, "\n%s]", indent);
+}
@@ -0,0 +1,192 @@
+#include "tiled_subdivision.h"
+
+// C++ std
+#include <algorithm>
+
+#include "mesh.h"
+#include "parallel.h"
+#include "spatial_order.h"
+
+// Peak memory of a tile per output quad, one-ring and temporaries included
+const size_t BYTES_PER_QUAD = 480;
+
+// Tiles of tiledSubdivide are sized for the L2 cache of a recent core
+const size_t TILE_BYTES = size_t(2) << 20;
+
+/*
+============================================================================================
+ Grid numbering
+============================================================================================
+*/
+void CageGrid::init(const Vec<Vec4i> &cageFaces, const Topology &cageTopology, const Vec<int> &faceSlots, int level) {
+	faces = &cageFaces;
+	cage = &cageTopology;
+	slots = &faceSlots;
+	n = 1ll << level;
+	edgeBase = cageTopology.vertCount;
+	faceBase = edgeBase + cageTopology.edgeCount() * (n - 1);
+}
+
+long long CageGrid::vertex(int f, int x, int y, bool &owner) const {
+	const Vec4i &face = (*faces)[f];
+	const bool left = x == 0, right = x == n, bottom = y == 0, top = y == n;
+	if ((left || right) && (bottom || top)) {
+		const int j = bottom ? (left ? 0 : 1) : (right ? 2 : 3);
+		const int v = face[j];
+		owner = cage->vertFaces[cage->vertFaceOffsets[v]] == f;
+		return v;
+	}
+
+	if (left || right || bottom || top) {
+		const int j = bottom ? 0 : right ? 1 : top ? 2 : 3;
+		const long long k = bottom ? x : right ? y : top ? n - x : n - y; // from face vertex j
+		const int e = cage->faceEdges[f][j];
+		owner = cage->edgeFaces[e].x == f;
+		const bool forward = cage->edgeVerts[e].x == face[j];
+		return edgeBase + e * (n - 1) + (forward ? k - 1 : n - 1 - k);
+	}
+
+	owner = true;
+	return faceBase + (*slots)[f] * (n - 1) * (n - 1) + (y - 1) * (n - 1) + (x - 1);
+}
+
+/*
+============================================================================================
+ Tiles
+============================================================================================
+*/
+int tileFaceCount(int faceCount, int level, size_t bytes) {
+	return int(Min<size_t>(faceCount, Max<size_t>(1, bytes / (BYTES_PER_QUAD << (2 * level)))));
+}
+
+void refineTile(const Vec<Vec3> &cagePs, const Vec<Vec4i> &cageFaces, const Topology &cage,
+	const int *tileFaces, int count, int level, AdaptiveLevel &tile) {
+	// The tile faces, then the faces sharing a vertex with them
+	Vec<int> own(tileFaces, tileFaces + count);
+	std::sort(own.begin(), own.end());
+	Vec<int> ring;
+	for (int i = 0; i < count; ++i) {
+		for (int j = 0; j < Mesh::QUAD_FACE_VERTS; ++j) {
+			const int v = cageFaces[tileFaces[i]][j];
+			for (int k = cage.vertFaceOffsets[v]; k < cage.vertFaceOffsets[v + 1]; ++k) {
+				if (!std::binary_search(own.begin(), own.end(), cage.vertFaces[k])) {
+					ring.push_back(cage.vertFaces[k]);
+				}
+			}
+		}
+	}
+	std::sort(ring.begin(), ring.end());
+	ring.erase(std::unique(ring.begin(), ring.end()), ring.end());
+
+	Vec<int> ids(tileFaces, tileFaces + count);
+	ids.insert(ids.end(), ring.begin(), ring.end());
+
+	Vec<int> verts;
+	verts.reserve(4 * ids.size());
+	for (int g : ids) {
+		const Vec4i &face = cageFaces[g];
+		verts.insert(verts.end(), { face[0], face[1], face[2], face[3] });
+	}
+	std::sort(verts.begin(), verts.end());
+	verts.erase(std::unique(verts.begin(), verts.end()), verts.end());
+
+	AdaptiveLevel lvl, next;
+	lvl.ps.resize(verts.size());
+	for (int i = 0; i < int(verts.size()); ++i) {
+		lvl.ps[i] = cagePs[verts[i]];
+	}
+	lvl.faces.resize(ids.size());
+	lvl.owned.resize(ids.size());
+	lvl.origins.resize(ids.size());
+	for (int i = 0; i < int(ids.size()); ++i) {
+		const Vec4i &face = cageFaces[ids[i]];
+		for (int j = 0; j < Mesh::QUAD_FACE_VERTS; ++j) {
+			lvl.faces[i][j] = int(std::lower_bound(verts.begin(), verts.end(), face[j]) - verts.begin());
+		}
+		lvl.owned[i] = i < count;
+		lvl.origins[i] = { ids[i], 0, { 0, 0 } };
+	}
+	buildTopology(lvl.faces, lvl.ps.size(), lvl.topology);
+
+	// Depth-first: the tile goes down all levels before the next one starts
+	for (int l = 0; l < level; ++l) {
+		Vec<char> kind(lvl.faces.size());
+		for (int f = 0; f < int(kind.size()); ++f) {
+			kind[f] = lvl.owned[f] ? FACE_REFINE : FACE_SKIP;
+		}
+		refineAround(lvl, kind, next);
+		std::swap(lvl, next);
+	}
+	tile = std::move(lvl);
+}
+
+void writeTile(const AdaptiveLevel &tile, const CageGrid &grid, Vec3 *points, Vec4i *quads) {
+	const long long n = grid.n;
+	parallelFor(int(tile.faces.size()), [&](int begin, int end) {
+		for (int f = begin; f < end; ++f) {
+			if (!tile.owned[f]) {
+				continue;
+			}
+			const FaceOrigin &o = tile.origins[f];
+			const Vec4i &face = tile.faces[f];
+			const int x = o.cell.x, y = o.cell.y;
+			const Vec2i corners[4] = { { x, y }, { x + 1, y }, { x + 1, y + 1 }, { x, y + 1 } };
+			// Quad (x, y) writes its corner 0, the last row and column also the far corners
+			const bool writes[4] = { true, x + 1 == n, x + 1 == n && y + 1 == n, y + 1 == n };
+
+			Vec4i quad;
+			for (int j = 0; j < Mesh::QUAD_FACE_VERTS; ++j) {
+				bool owner;
+				const long long v = grid.vertex(o.face, corners[j].x, corners[j].y, owner);
+				if (writes[j] && owner) {
+					points[v] = tile.ps[face[j]];
+				}
+				quad[j] = int(v);
+			}
+			if (quads) {
+				quads[(*grid.slots)[o.face] * n * n + y * n + x] = quad;
+			}
+		}
+	}, 256);
+}
+
+/*
+============================================================================================
+ Tiled subdivision
+============================================================================================
+*/
+// Quads are only written when faces is given
+void tiledRefine(const Vec<Vec3> &cagePs, const Vec<Vec4i> &cageFaces, int level, Vec<Vec3> &ps, Vec<Vec4i> *faces) {
+	const int faceCount = int(cageFaces.size());
+	Topology cage;
+	buildTopology(cageFaces, cagePs.size(), cage);
+
+	Vec<int> slots(faceCount);
+	for (int f = 0; f < faceCount; ++f) {
+		slots[f] = f;
+	}
+	CageGrid grid;
+	grid.init(cageFaces, cage, slots, level);
+	resizeExact(ps, grid.vertCount());
+	if (faces) {
+		resizeExact(*faces, grid.quadCount());
+	}
+
+	const Vec<int> order = mortonOrder(cagePs, cageFaces);
+	const int tileFaces = tileFaceCount(faceCount, level, TILE_BYTES);
+	const int tileCount = (faceCount + tileFaces - 1) / tileFaces;
+	parallelInvoke(tileCount, [&](int t) {
+		const int first = t * tileFaces;
+		AdaptiveLevel tile;
+		refineTile(cagePs, cageFaces, cage, &order[first], Min(tileFaces, faceCount - first), level, tile);
+		writeTile(tile, grid, ps.data(), faces ? faces->data() : nullptr);
+	});
+}
+
+void tiledSubdivide(const Vec<Vec3> &cagePs, const Vec<Vec4i> &cageFaces, int level, Vec<Vec3> &ps, Vec<Vec4i> &faces) {
+	tiledRefine(cagePs, cageFaces, level, ps, &faces);
+}
+
+void tiledPoints(const Vec<Vec3> &cagePs, const Vec<Vec4i> &cageFaces, int level, Vec<Vec3> &ps) {
+	tiledRefine(cagePs, cageFaces, level, ps, nullptr);
+}
@@ -0,0 +1,360 @@
+#include "topology.h"
+
+#include "mesh.h"
+#include "parallel.h"
+
+size_t Topology::bytes() const {
+	return bytesOf(faceEdges) + bytesOf(edgeVerts) + bytesOf(edgeFaces) +
+		bytesOf(vertEdgeOffsets) + bytesOf(vertEdges) + bytesOf(vertFaceOffsets) + bytesOf(vertFaces) + bytesOf(vertexRuns);
+}
+
+// Fill a CSR relation from (key, value) pairs with a counting sort over the dense keys.
+// Values of the same key keep the order in which they were emitted.
+template <class EmitFunc>
+void buildCSR(int keyCount, int pairCount, EmitFunc emit, Vec<int> &offsets, Vec<int> &indices) {
+	offsets.assign(keyCount + 1, 0);
+	emit([&offsets](int key, int) { ++offsets[key + 1]; });
+	for (int i = 0; i < keyCount; ++i) {
+		offsets[i + 1] += offsets[i];
+	}
+
+	indices.resize(pairCount);
+	Vec<int> cursor(offsets.begin(), offsets.end() - 1);
+	emit([&cursor, &indices](int key, int value) { indices[cursor[key]++] = value; });
+}
+
+void buildTopology(const Vec<Vec4i> &faces, int vertCount, Topology &topology) {
+	const int Q = Mesh::QUAD_FACE_VERTS;
+	const int halfCount = Q * int(faces.size());
+	const int vertBits = bitsFor(vertCount);
+
+	topology.vertCount = vertCount;
+	topology.faceEdges.resize(faces.size());
+
+	// Pack every half-edge as (min vert, max vert) so both directions of an edge get the same key.
+	// The value is the half-edge, 4 * f + j goes from face vertex j to face vertex j + 1.
+	Vec<SortKey> keys(halfCount);
+	parallelFor(halfCount, [&](int begin, int end) {
+		for (int h = begin; h < end; ++h) {
+			const int a = faces[h / Q][h % Q];
+			const int b = faces[h / Q][(h + 1) % Q];
+			keys[h].key = (uint64_t(Min(a, b)) << vertBits) | uint64_t(Max(a, b));
+			keys[h].value = h;
+		}
+	});
+
+	radixSort(keys, 2 * vertBits);
+
+	// After sorting, the half-edges of each edge are adjacent. The first one of each run
+	// defines the edge, the scan of the run starts gives the edge indices.
+	const int n = rangeCount(halfCount);
+	Vec<int> runStarts(n + 1, 0);
+	auto isRunStart = [&keys](int i) {
+		return i == 0 || keys[i].key != keys[i - 1].key;
+	};
+
+	parallelInvoke(n, [&](int t) {
+		const Range r = splitRange(halfCount, n, t);
+		int cnt = 0;
+		for (int i = r.begin; i < r.end; ++i) {
+			cnt += isRunStart(i);
+		}
+		runStarts[t + 1] = cnt;
+	});
+	for (int t = 0; t < n; ++t) {
+		runStarts[t + 1] += runStarts[t];
+	}
+
+	const int edgeCount = runStarts[n];
+	topology.edgeVerts.resize(edgeCount);
+	topology.edgeFaces.resize(edgeCount);
+
+	parallelInvoke(n, [&](int t) {
+		const Range r = splitRange(halfCount, n, t);
+		int eIdx = runStarts[t];
+		for (int i = r.begin; i < r.end; ++i) {
+			if (!isRunStart(i)) {
+				continue;
+			}
+
+			// Edge keeps the direction of the half-edge met first in face order
+			const int h = keys[i].value;
+			topology.edgeVerts[eIdx] = { faces[h / Q][h % Q], faces[h / Q][(h + 1) % Q] };
+			topology.edgeFaces[eIdx] = { h / Q, -1 };
+			topology.faceEdges[h / Q][h % Q] = eIdx;
+
+			for (int j = i + 1; j < halfCount && !isRunStart(j); ++j) {
+				const int other = keys[j].value;
+				topology.faceEdges[other / Q][other % Q] = eIdx;
+				// Non-manifold edges keep their first two faces only
+				if (topology.edgeFaces[eIdx].y == -1) {
+					topology.edgeFaces[eIdx].y = other / Q;
+				}
+			}
+			++eIdx;
+		}
+	});
+
+	const int faceCount = faces.size();
+
+	// for each vert -> edge indices
+	buildCSR(vertCount, 2 * edgeCount, [&](auto &&out) {
+		for (int e = 0; e < edgeCount; ++e) {
+			out(topology.edgeVerts[e].x, e);
+			out(topology.edgeVerts[e].y, e);
+		}
+	}, topology.vertEdgeOffsets, topology.vertEdges);
+
+	// for each vert -> face indices
+	buildCSR(vertCount, Q * faceCount, [&](auto &&out) {
+		for (int f = 0; f < faceCount; ++f) {
+			for (int j = 0; j < Q; ++j) {
+				out(faces[f][j], f);
+			}
+		}
+	}, topology.vertFaceOffsets, topology.vertFaces);
+
+	classifyVertices(topology);
+}
+
+/*
+============================================================================================
+ Vertex classes
+============================================================================================
+*/
+VertexClass vertexClassOf(const Topology &topology, int v) {
+	const int edges = topology.edgeValence(v);
+	const int faces = topology.faceValence(v);
+	if (edges == faces) {
+		switch (edges) {
+		case 3: return Interior3;
+		case 4: return Interior4;
+		case 5: return Interior5;
+		case 6: return Interior6;
+		default: return GenericVertex;
+		}
+	}
+	if (edges == faces + 1 && (edges == 2 || edges == 3)) {
+		int border = 0;
+		for (int j = topology.vertEdgeOffsets[v]; j < topology.vertEdgeOffsets[v + 1]; ++j) {
+			border += topology.isBoundaryEdge(topology.vertEdges[j]);
+		}
+		if (border == 2) {
+			return edges == 2 ? Corner : Border3;
+		}
+	}
+	return GenericVertex;
+}
+
+// Appends [begin, end) of class c, merged into the last run if it has the same class
+inline void addRun(Vec<VertexRun> &runs, int begin, int end, VertexClass c) {
+	if (begin == end) {
+		return;
+	}
+	if (!runs.empty() && runs.back().vertexClass == c && runs.back().end == begin) {
+		runs.back().end = end;
+	} else {
+		runs.push_back({ begin, end, c });
+	}
+}
+
+// The runs found by each range, in range order
+void joinRuns(const Vec<Vec<VertexRun>> &partial, Vec<VertexRun> &runs) {
+	for (const Vec<VertexRun> &part : partial) {
+		for (const VertexRun &run : part) {
+			addRun(runs, run.begin, run.end, run.vertexClass);
+		}
+	}
+}
+
+void classifyVertices(Topology &topology) {
+	const int n = rangeCount(topology.vertCount);
+	Vec<Vec<VertexRun>> partial(n);
+	parallelInvoke(n, [&](int t) {
+		const Range r = splitRange(topology.vertCount, n, t);
+		for (int v = r.begin; v < r.end; ++v) {
+			addRun(partial[t], v, v + 1, vertexClassOf(topology, v));
+		}
+	});
+	topology.vertexRuns.clear();
+	joinRuns(partial, topology.vertexRuns);
+}
+
+/*
+============================================================================================
+ Refinement
+============================================================================================
+*/
+
+inline int halfEdge(const Topology &parent, int e, int v) {
+	return parent.edgeVerts[e].x == v ? 2 * e : 2 * e + 1;
+}
+
+void refineTopology(const Vec<Vec4i> &faces, const Topology &parent, Vec<Vec4i> &childFaces, Topology &child) {
+	const int n = parent.vertCount;
+	const int m = parent.faceCount();
+	const int k = parent.edgeCount();
+	const int Q = Mesh::QUAD_FACE_VERTS;
+
+	child.vertCount = n + m + k;
+	resizeExact(childFaces, Q * m);
+	resizeExact(child.faceEdges, Q * m);
+	resizeExact(child.edgeVerts, 2 * k + Q * m);
+	resizeExact(child.edgeFaces, 2 * k + Q * m);
+
+	// Every parent edge is split in two halves: 2e touches edgeVerts[e].x, 2e + 1 touches edgeVerts[e].y.
+	// The class runs of the edge points come along if the parent has runs.
+	const int edgeRanges = rangeCount(k);
+	Vec<Vec<VertexRun>> edgeRuns(parent.vertexRuns.empty() ? 0 : edgeRanges);
+	parallelInvoke(edgeRanges, [&](int t) {
+		const Range r = splitRange(k, edgeRanges, t);
+		for (int e = r.begin; e < r.end; ++e) {
+			const Vec2i ev = parent.edgeVerts[e];
+			const int ep = n + m + e;
+			child.edgeVerts[2 * e + 0] = { ev.x, ep };
+			child.edgeVerts[2 * e + 1] = { ep, ev.y };
+
+			Vec2i halfFaces[2] = { { -1, -1 }, { -1, -1 } };
+			for (int i = 0; i < 2; ++i) {
+				const int f = parent.edgeFaces[e][i];
+				if (f < 0) {
+					continue;
+				}
+				const int j = localIndex(parent.faceEdges[f], e);
+				// child 4f + j touches face vertex j, child 4f + j + 1 touches face vertex j + 1
+				const bool forward = faces[f][j] == ev.x;
+				halfFaces[0][i] = Q * f + (forward ? j : (j + 1) % Q);
+				halfFaces[1][i] = Q * f + (forward ? (j + 1) % Q : j);
+			}
+			child.edgeFaces[2 * e + 0] = halfFaces[0];
+			child.edgeFaces[2 * e + 1] = halfFaces[1];
+			if (!edgeRuns.empty()) {
+				addRun(edgeRuns[t], ep, ep + 1, halfFaces[0].y == -1 ? Border3 : Interior4);
+			}
+		}
+	});
+
+	// Every parent face gets 4 new edges connecting its edge points to its face point
+	// and is split in 4 faces keeping the orientation of the parent.
+	parallelFor(m, [&](int begin, int end) {
+		for (int f = begin; f < end; ++f) {
+			const Vec4i face = faces[f];
+			const Vec4i fe = parent.faceEdges[f];
+			const int fp = n + f;
+			const int inner = 2 * k + Q * f;
+
+			for (int j = 0; j < Q; ++j) {
+				const int prev = (j + Q - 1) % Q;
+				child.edgeVerts[inner + j] = { n + m + fe[j], fp };
+				child.edgeFaces[inner + j] = { Q * f + j, Q * f + (j + 1) % Q };
+
+				Vec4i cf, cfe;
+				cf[j] = face[j];
+				cf[(j + 1) % Q] = n + m + fe[j];
+				cf[(j + 2) % Q] = fp;
+				cf[(j + 3) % Q] = n + m + fe[prev];
+
+				cfe[j] = halfEdge(parent, fe[j], face[j]);
+				cfe[(j + 1) % Q] = inner + j;
+				cfe[(j + 2) % Q] = inner + prev;
+				cfe[(j + 3) % Q] = halfEdge(parent, fe[prev], face[j]);
+
+				childFaces[Q * f + j] = cf;
+				child.faceEdges[Q * f + j] = cfe;
+			}
+		}
+	});
+
+	// Vertex relations. The sizes are known upfront:
+	// parent verts keep their valence, face points have 4 edges and faces,
+	// edge points have 2 + #faces edges and 2 * #faces faces.
+	Vec<int> &eOff = child.vertEdgeOffsets;
+	Vec<int> &fOff = child.vertFaceOffsets;
+	resizeExact(eOff, child.vertCount + 1);
+	resizeExact(fOff, child.vertCount + 1);
+	eOff[child.vertCount] = fOff[child.vertCount] = 0;
+	parallelFor(child.vertCount, [&](int begin, int end) {
+		for (int v = begin; v < end; ++v) {
+			if (v < n) {
+				eOff[v] = parent.edgeValence(v);
+				fOff[v] = parent.faceValence(v);
+			} else if (v < n + m) {
+				eOff[v] = fOff[v] = Q;
+			} else {
+				const int faceCount = parent.isBoundaryEdge(v - n - m) ? 1 : 2;
+				eOff[v] = 2 + faceCount;
+				fOff[v] = 2 * faceCount;
+			}
+		}
+	});
+	parallelScan(eOff);
+	parallelScan(fOff);
+
+	resizeExact(child.vertEdges, eOff[child.vertCount]);
+	resizeExact(child.vertFaces, fOff[child.vertCount]);
+
+	// The classes follow from the refinement, no vertex is looked at
+	child.vertexRuns.clear();
+	if (!parent.vertexRuns.empty()) {
+		child.vertexRuns = parent.vertexRuns;
+		addRun(child.vertexRuns, n, n + m, Interior4);
+		joinRuns(edgeRuns, child.vertexRuns);
+	}
+
+	parallelFor(n, [&](int begin, int end) {
+		for (int v = begin; v < end; ++v) {
+			int ei = eOff[v];
+			for (int i = parent.vertEdgeOffsets[v]; i < parent.vertEdgeOffsets[v + 1]; ++i) {
+				child.vertEdges[ei++] = halfEdge(parent, parent.vertEdges[i], v);
+			}
+			int fi = fOff[v];
+			for (int i = parent.vertFaceOffsets[v]; i < parent.vertFaceOffsets[v + 1]; ++i) {
+				const int f = parent.vertFaces[i];
+				child.vertFaces[fi++] = Q * f + localIndex(faces[f], v);
+			}
+		}
+	});
+
+	parallelFor(m, [&](int begin, int end) {
+		for (int f = begin; f < end; ++f) {
+			for (int j = 0; j < Q; ++j) {
+				child.vertEdges[eOff[n + f] + j] = 2 * k + Q * f + j;
+				child.vertFaces[fOff[n + f] + j] = Q * f + j;
+			}
+		}
+	});
+
+	parallelFor(k, [&](int begin, int end) {
+		for (int e = begin; e < end; ++e) {
+			int ei = eOff[n + m + e];
+			int fi = fOff[n + m + e];
+			child.vertEdges[ei++] = 2 * e;
+			child.vertEdges[ei++] = 2 * e + 1;
+			for (int i = 0; i < 2; ++i) {
+				const int f = parent.edgeFaces[e][i];
+				if (f < 0) {
+					continue;
+				}
+				const int j = localIndex(parent.faceEdges[f], e);
+				child.vertEdges[ei++] = 2 * k + Q * f + j;
+				child.vertFaces[fi++] = Q * f + j;
+				child.vertFaces[fi++] = Q * f + (j + 1) % Q;
+			}
+		}
+	});
+}
+
+void triangulate(const Vec<Vec4i> &faces, Vec<Vec3i> &triFaces) {
+	resizeExact(triFaces, faces.size() * 2);
+	triangulate(faces.data(), int(faces.size()), triFaces.data());
+}
+
+void triangulate(const Vec4i *faces, int count, Vec3i *triFaces) {
+	parallelFor(count, [&](int begin, int end) {
+		for (int i = begin; i < end; ++i) {
+			auto f = faces[i];
+			triFaces[2 * i + 0] = { f[0], f[1], f[2] };
+			triFaces[2 * i + 1] = { f[0], f[2], f[3] };
+		}
+	});
+}
@@ -0,0 +1,74 @@
+#include "topology_cache.h"
+
+const TopologyLevel& RefinementTopology::level(int l) {
+	std::lock_guard<std::mutex> lock(mutex);
+	while (int(levels.size()) <= l) {
+		const TopologyLevel &parent = *levels.back();
+		std::unique_ptr<TopologyLevel> child(new TopologyLevel);
+		refineTopology(parent.faces, parent.topology, child->faces, child->topology);
+		triangulate(child->faces, child->triFaces);
+		levels.push_back(std::move(child));
+	}
+	return *levels[l];
+}
+
+int RefinementTopology::levelCount() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return int(levels.size());
+}
+
+size_t RefinementTopology::bytes() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	size_t bytes = 0;
+	for (const std::unique_ptr<TopologyLevel> &l : levels) {
+		bytes += bytesOf(l->faces) + l->topology.bytes() + bytesOf(l->triFaces);
+	}
+	return bytes;
+}
+
+// FNV-1a over the vertex count and the face indices
+uint64_t connectivityHash(const Vec<Vec4i> &faces, int vertCount) {
+	uint64_t hash = 14695981039346656037ull;
+	auto add = [&](int value) {
+		for (int b = 0; b < 4; ++b) {
+			hash = (hash ^ ((unsigned(value) >> (8 * b)) & 0xFF)) * 1099511628211ull;
+		}
+	};
+	add(vertCount);
+	for (const Vec4i &face : faces) {
+		add(face[0]);
+		add(face[1]);
+		add(face[2]);
+		add(face[3]);
+	}
+	return hash;
+}
+
+std::shared_ptr<RefinementTopology> sharedTopology(const Vec<Vec4i> &cageFaces, int vertCount) {
+	// Refinement topologies alive, by hash. Faces are compared too, a hash may collide.
+	static std::mutex registryMutex;
+	static HashMap<uint64_t, Vec<std::weak_ptr<RefinementTopology>>> registry;
+
+	const uint64_t key = connectivityHash(cageFaces, vertCount);
+	std::lock_guard<std::mutex> lock(registryMutex);
+	Vec<std::weak_ptr<RefinementTopology>> &bucket = registry[key];
+	for (int i = int(bucket.size()) - 1; i >= 0; --i) {
+		std::shared_ptr<RefinementTopology> known = bucket[i].lock();
+		if (!known) {
+			bucket.erase(bucket.begin() + i);
+		} else if (known->vertCount == vertCount && known->level(0).faces == cageFaces) {
+			return known;
+		}
+	}
+
+	std::shared_ptr<RefinementTopology> refinement = std::make_shared<RefinementTopology>();
+	refinement->key = key;
+	refinement->vertCount = vertCount;
+	std::unique_ptr<TopologyLevel> base(new TopologyLevel);
+	base->faces = cageFaces;
+	buildTopology(base->faces, vertCount, base->topology);
+	triangulate(base->faces, base->triFaces);
+	refinement->levels.push_back(std::move(base));
+	bucket.push_back(refinement);
+	return refinement;
+}
@@ -1,6 +1,12 @@
 #include "ui_engine.h"
+#include "benchmark.h"
 #include "opengl_engine.h"
 #include "mesh.h"
+#include "parallel.h"
+#include "streaming_subdivision.h"
+
+// C++ std
+#include <memory>
 
 UIEngine *ui = nullptr;
 UIEngine* UIInit(GLFWwindow *window) {
@@ -105,9 +111,235 @@ void UIEngine::drawMainWindow() {
 
 	bool sliderActive = drawColorEdit("Background color", bgColor);
 
-	if (ImGui::Button("Subdivide")) {
-		opengl->mesh->subdivide();
+	Mesh *mesh = opengl->mesh;
+	if (const SubdivisionJob *job = mesh->subdivisionJob()) {
+		ImGui::ProgressBar(job->progress(), ImVec2(-1.f, 0.f), job->stageName());
+		if (ImGui::Button("Cancel")) {
+			mesh->cancelSubdivision();
+		}
+	} else if (ImGui::Button("Subdivide")) {
+		mesh->subdivideAsync();
+	}
+
+	// OBJ or binary PLY, read while the UI waits
+	static char cagePath[512] = "";
+	static bool importFailed = false;
+	static ImportTimings importTimings;
+	ImGui::InputText("Cage file", cagePath, sizeof(cagePath));
+	if (ImGui::Button("Import")) {
+		importFailed = !mesh->importMesh(cagePath);
+	}
+	ImGui::SameLine();
+	if (ImGui::Button("Benchmark import")) {
+		importTimings = benchmarkImport(cagePath);
+	}
+	if (importFailed) {
+		ImGui::Text("Cannot import the file, see the console");
+	}
+	if (importTimings.vertCount > 0) {
+		ImGui::Text("%d vertices, %d faces: mapped %.1f ms, iostreams %.1f ms%s", importTimings.vertCount, importTimings.faceCount,
+			importTimings.mappedMs, importTimings.streamMs, importTimings.match ? "" : ", not the same cage");
+	}
+
+	// The current level, PLY or native by the extension
+	static char exportPath[512] = "level.ply";
+	static bool exportFailed = false;
+	static ExportStats exportStats;
+	ImGui::InputText("Export file", exportPath, sizeof(exportPath));
+	if (ImGui::Button("Export level")) {
+		exportFailed = !mesh->exportLevel(exportPath, &exportStats);
+	}
+	if (exportFailed) {
+		ImGui::Text("Cannot export the level, see the console");
+	} else if (exportStats.bytes > 0) {
+		ImGui::Text("%.1f MB in %.1f ms (%.1f ms to disk), %.0f MB/s", exportStats.bytes / double(1 << 20),
+			exportStats.ms, exportStats.syncMs, exportStats.mbPerSecond());
+	}
+
+	// A new pool for the next loops, those running on the old one finish there
+	static int threads = threadCount();
+	ImGui::SliderInt("Subdivision threads", &threads, 1, 64);
+	if (ImGui::IsItemDeactivatedAfterEdit()) {
+		setThreadCount(threads);
+	}
+
+	int level = mesh->level;
+	if (ImGui::SliderInt("Level", &level, 0, mesh->maxLevel)) {
+		mesh->setLevel(level);
+	}
+	sliderActive |= ImGui::IsItemActive();
+
+	static int budgetMB = int(mesh->cacheBudget >> 20);
+	ImGui::SliderInt("Level cache (MB)", &budgetMB, 0, 16384);
+	sliderActive |= ImGui::IsItemActive();
+	if (ImGui::IsItemDeactivatedAfterEdit()) {
+		mesh->setCacheBudget(size_t(budgetMB) << 20);
+	}
+	ImGui::Text("%d levels cached, %.1f MB", mesh->cachedLevelCount(), mesh->cacheBytes() / float(1 << 20));
+
+	// Levels larger than this are written to their buffers over several frames
+	int uploadMB = int(opengl->uploadBudget >> 20);
+	if (ImGui::SliderInt("Upload per frame (MB)", &uploadMB, 1, 1024)) {
+		opengl->uploadBudget = size_t(uploadMB) << 20;
 	}
+	sliderActive |= ImGui::IsItemActive();
+	const OpenGLEngine::Upload &upload = opengl->upload;
+	if (upload.level >= 0) {
+		const size_t total = upload.pointBytes + upload.normalBytes + upload.indexBytes;
+		const size_t done = upload.pointsDone + upload.normalsDone + upload.indicesDone;
+		ImGui::ProgressBar(total ? done / float(total) : 1.f, ImVec2(-1, 0), "Uploading");
+	}
+	ImGui::Text("%s buffers, %d spare", opengl->bufferStorage ? "Persistently mapped" : "Plain", int(opengl->spareBuffers.size()));
+
+	bool adaptive = mesh->adaptiveMode;
+	if (ImGui::Checkbox("Adaptive subdivision", &adaptive)) {
+		mesh->setAdaptive(adaptive);
+	}
+
+	if (mesh->adaptiveMode) {
+		static int patchRate = mesh->patchRate;
+		ImGui::SliderInt("Patch tessellation", &patchRate, 1, 8);
+		if (ImGui::IsItemDeactivatedAfterEdit()) {
+			mesh->setPatchRate(patchRate);
+		}
+		ImGui::Text("%d patches, %d irregular faces", int(mesh->adaptive.patches.size()), int(mesh->adaptive.faces.size()));
+		if (mesh->adaptive.patchRate(mesh->patchRate) != mesh->patchRate) {
+			ImGui::Text("Tessellated at rate 1, the irregular faces would leave cracks otherwise");
+		}
+	} else {
+		bool limit = mesh->limitProjection;
+		if (ImGui::Checkbox("Project to limit surface", &limit)) {
+			mesh->setLimitProjection(limit);
+		}
+
+		int engine = int(mesh->engine);
+		if (ImGui::Combo("Engine", &engine, "Global, level by level\0Tiled, depth-first\0")) {
+			mesh->setEngine(SubdivisionEngine(engine));
+		}
+		if (mesh->engine == SubdivisionEngine::Global) {
+			bool ordered = mesh->spatialOrder;
+			if (ImGui::Checkbox("Spatial vertex order", &ordered)) {
+				mesh->setSpatialOrder(ordered);
+			}
+			bool shared = mesh->shareTopology;
+			if (ImGui::Checkbox("Share topology between meshes", &shared)) {
+				mesh->setShareTopology(shared);
+			}
+			if (mesh->refinement) {
+				ImGui::Text("Shared topology: %d levels, %.1f MB", mesh->refinement->levelCount(), mesh->refinement->bytes() / float(1 << 20));
+			}
+		} else {
+			bool grids = mesh->gridStorage;
+			if (ImGui::Checkbox("Store levels as grids", &grids)) {
+				mesh->setGridStorage(grids);
+			}
+		}
+		if (!mesh->grid.empty()) {
+			// What the quads and their triangles would take on top of the points
+			const size_t explicitBytes = size_t(mesh->grid.quadCount()) * (sizeof(Vec4i) + 2 * sizeof(Vec3i));
+			ImGui::Text("Level %.1f MB as grids, explicit quads would add %.1f MB",
+				mesh->levelBytes() / float(1 << 20), explicitBytes / float(1 << 20));
+		}
+
+		// Blocks the UI while it runs, from the cage to the next level
+		static EngineTimings timings;
+		if (ImGui::Button("Benchmark engines")) {
+			timings = benchmarkEngines(mesh->cagePoints(), mesh->cageQuads(), Max(1, mesh->level + 1));
+		}
+		if (timings.level > 0) {
+			ImGui::Text("Level %d: global %.1f ms, tiled %.1f ms", timings.level, timings.globalMs, timings.tiledMs);
+		}
+
+		// From the cage to the next level, a second mesh with the same cage faces against the first
+		static SharedTopologyTimings sharedTimings;
+		if (ImGui::Button("Benchmark shared topology")) {
+			sharedTimings = benchmarkSharedTopology(mesh->cagePoints(), mesh->cageQuads(), Max(1, mesh->level + 1));
+		}
+		if (sharedTimings.level > 0) {
+			ImGui::Text("Level %d: own topology %.1f ms, shared %.1f ms", sharedTimings.level, sharedTimings.ownMs, sharedTimings.sharedMs);
+		}
+
+		// From the current level to the next one
+		static OrderTimings orderTimings;
+		if (ImGui::Button("Benchmark vertex order")) {
+			orderTimings = benchmarkSpatialOrder(mesh->cagePoints(), mesh->cageQuads(), mesh->level);
+		}
+		if (orderTimings.plainMs > 0.0) {
+			ImGui::Text("Next level: %.1f ms as refined, %.1f ms sorted, sorting %.1f ms",
+				orderTimings.plainMs, orderTimings.orderedMs, orderTimings.reorderMs);
+			ImGui::Text("Vertex fetch misses per triangle: %.3f as refined, %.3f sorted",
+				orderTimings.plainFetchMisses, orderTimings.orderedFetchMisses);
+		}
+	}
+
+	ImGui::Separator();
+	ImGui::Text("Subdivision profile");
+#if SUBDIVISION_PROFILE
+	// The last computation and upload of each level, one table per level
+	for (const LevelProfile &level : mesh->profile.levels) {
+		if (level.level < 0) {
+			continue;
+		}
+		ImGui::PushID(level.level);
+		if (ImGui::TreeNode("level", "Level %d: %.1f ms", level.level, level.ms())) {
+			ImGui::Columns(5, "phases");
+			ImGui::Text("Phase"); ImGui::NextColumn();
+			ImGui::Text("ms"); ImGui::NextColumn();
+			ImGui::Text("Elements"); ImGui::NextColumn();
+			ImGui::Text("Allocated MB"); ImGui::NextColumn();
+			ImGui::Text("Uploaded MB"); ImGui::NextColumn();
+			ImGui::Separator();
+			for (int p = 0; p < PHASE_COUNT; ++p) {
+				const PhaseStats &stats = level.phases[p];
+				if (!stats.calls) {
+					continue;
+				}
+				ImGui::Text("%s", phaseName(Phase(p))); ImGui::NextColumn();
+				ImGui::Text("%.2f", stats.ms); ImGui::NextColumn();
+				ImGui::Text("%lld", stats.elements); ImGui::NextColumn();
+				ImGui::Text("%.1f", stats.allocatedBytes / double(1 << 20)); ImGui::NextColumn();
+				ImGui::Text("%.1f", stats.uploadedBytes / double(1 << 20)); ImGui::NextColumn();
+			}
+			ImGui::Columns(1);
+			ImGui::TreePop();
+		}
+		ImGui::PopID();
+	}
+
+	static char profilePath[512] = "profile.json";
+	static bool profileFailed = false;
+	ImGui::InputText("Profile file", profilePath, sizeof(profilePath));
+	if (ImGui::Button("Dump profile")) {
+		profileFailed = !mesh->profile.writeJson(profilePath);
+	}
+	ImGui::SameLine();
+	if (ImGui::Button("Clear profile")) {
+		mesh->profile.clear();
+	}
+	if (profileFailed) {
+		ImGui::Text("Cannot write the profile, see the console");
+	}
+#else
+	ImGui::Text("Built without SUBDIVISION_PROFILE");
+#endif
+
+	ImGui::Separator();
+	ImGui::Text("View-dependent tessellation");
+
+	// Replaces the levels on screen, each cage face refined after its size in pixels
+	if (ImGui::Checkbox("Tessellate from the view", &opengl->viewDependent) && !opengl->viewDependent) {
+		opengl->deletePatchPools();
+		opengl->viewTessellation.clear();
+	}
+	if (opengl->viewDependent) {
+		ViewTessellation &tessellation = opengl->viewTessellation;
+		ImGui::SliderFloat("Quad size (pixels)", &tessellation.quadPixels, 1.f, 64.f);
+		sliderActive |= ImGui::IsItemActive();
+		ImGui::SliderInt("Max patch level", &tessellation.maxLevel, 0, 8);
+		sliderActive |= ImGui::IsItemActive();
+		ImGui::Text("%lld triangles, %d patches uploaded last frame", tessellation.triangleCount(), opengl->patchesUploaded);
+	}
+	ImGui::Separator();
 
 	static unsigned mode = GL_FILL;
 	if (ImGui::Button("Switch draw mode")) {
@@ -115,6 +347,63 @@ void UIEngine::drawMainWindow() {
 		glPolygonMode(GL_FRONT, mode);
 	}
 	
+	ImGui::Separator();
+	ImGui::Text("Cage editing");
+
+	static int cageVert = 0;
+	cageVert = Min(cageVert, mesh->cageVertCount() - 1);
+	ImGui::SliderInt("Cage vertex", &cageVert, 0, mesh->cageVertCount() - 1);
+	sliderActive |= ImGui::IsItemActive();
+	Vec3 cagePos = mesh->cageVertex(cageVert);
+	if (ImGui::DragFloat3("Position", &cagePos.x, 0.005f)) {
+		mesh->setCageVertex(cageVert, cagePos);
+	}
+	sliderActive |= ImGui::IsItemActive();
+
+	ImGui::Separator();
+	ImGui::Text("Out-of-core subdivision");
+
+	static char streamPath[256] = "level.ccs";
+	static int streamLevel = 8;
+	static int workingSetMB = 256;
+	static std::unique_ptr<StreamingSubdivision> streaming;
+	static bool exportStreamed = false;
+	ImGui::InputText("File", streamPath, sizeof(streamPath));
+	ImGui::Checkbox("Export it too", &exportStreamed);
+	if (exportStreamed) {
+		ImGui::SameLine();
+		ImGui::Text("to %s", exportPath);
+	}
+	ImGui::SliderInt("Streamed level", &streamLevel, 1, 12);
+	sliderActive |= ImGui::IsItemActive();
+	ImGui::SliderInt("Working set (MB)", &workingSetMB, 16, 4096);
+	sliderActive |= ImGui::IsItemActive();
+	if (streaming && !streaming->done()) {
+		ImGui::ProgressBar(streaming->progress());
+		if (ImGui::Button("Cancel streaming")) {
+			streaming->cancel();
+		}
+	} else {
+		if (ImGui::Button("Stream to file")) {
+			streaming.reset(new StreamingSubdivision);
+			streaming->level = streamLevel;
+			streaming->workingSet = size_t(workingSetMB) << 20;
+			streaming->cagePs = mesh->cagePoints();
+			streaming->cageFaces = mesh->cageQuads();
+			streaming->path = streamPath;
+			streaming->exportPath = exportStreamed ? exportPath : "";
+			streaming->start();
+		}
+		ImGui::SameLine();
+		if (ImGui::Button("Show file")) {
+			opengl->showStreamed(streamPath);
+		}
+	}
+	if (streaming && streaming->done() && streaming->exportStats.bytes > 0) {
+		const ExportStats &stats = streaming->exportStats;
+		ImGui::Text("Exported %.1f MB at %.0f MB/s", stats.bytes / double(1 << 20), stats.mbPerSecond());
+	}
+
 	ImGui::Separator();
 	ImGui::Text("Mesh rotation");
 
@@ -0,0 +1,224 @@
+#include "view_tessellation.h"
+
+// C std
+#include <cmath>
+
+#include "mesh.h"
+
+// (u, v) of the point t along side j of a face, t from face vertex j
+Vec2 sideUV(int j, float t) {
+	switch (j) {
+	case 0: return { t, 0.f };
+	case 1: return { 1.f, t };
+	case 2: return { 1.f - t, 1.f };
+	default: return { 0.f, 1.f - t };
+	}
+}
+
+PatchVertex patchVertex(const Vec3 &p, const Vec3 &du, const Vec3 &dv) {
+	const Vec3 n = glm::cross(du, dv);
+	const float length = glm::length(n);
+	return { p, length > 0.f ? n / length : Vec3(0.f) };
+}
+
+void ViewTessellation::reset(const Vec<Vec3> &ps, const Vec<Vec4i> &faces, const LimitEvaluator &evaluator) {
+	cagePs = ps;
+	cageFaces = faces;
+	buildTopology(cageFaces, cagePs.size(), cage);
+
+	static const Vec2 cornerUV[4] = { { 0.f, 0.f }, { 1.f, 0.f }, { 1.f, 1.f }, { 0.f, 1.f } };
+	corners.assign(cagePs.size(), PatchVertex{ Vec3(0.f), Vec3(0.f) });
+	for (int v = 0; v < int(cagePs.size()); ++v) {
+		if (cage.faceValence(v) == 0) {
+			continue;
+		}
+		const int f = cage.vertFaces[cage.vertFaceOffsets[v]];
+		int j = 0;
+		while (cageFaces[f][j] != v) {
+			++j;
+		}
+		Vec3 du, dv;
+		const Vec3 p = evaluator.evaluate(f, cornerUV[j].x, cornerUV[j].y, &du, &dv);
+		corners[v] = patchVertex(p, du, dv);
+	}
+
+	levels.assign(cageFaces.size(), -1);
+	patches.assign(cageFaces.size(), {});
+	edgeLevels.assign(cage.edgeCount(), -1);
+	edgeSamples.assign(cage.edgeCount(), {});
+}
+
+void ViewTessellation::pickLevels(const glm::mat4 &mvp, int width, int height, Vec<int> &faceLevels) const {
+	Vec<Vec4> clip(corners.size());
+	for (int v = 0; v < int(corners.size()); ++v) {
+		clip[v] = mvp * Vec4(corners[v].p, 1.f);
+	}
+	const Vec2 viewport = { float(width), float(height) };
+
+	faceLevels.resize(cageFaces.size());
+	for (int f = 0; f < int(cageFaces.size()); ++f) {
+		const Vec4i &face = cageFaces[f];
+
+		// Outside of the frustum when all corners are past the same plane, behind the camera when w <= 0
+		bool outside = false;
+		for (int axis = 0; axis < 3 && !outside; ++axis) {
+			bool below = true, above = true;
+			for (int j = 0; j < Mesh::QUAD_FACE_VERTS; ++j) {
+				const Vec4 &c = clip[face[j]];
+				below &= c[axis] < -c.w;
+				above &= c[axis] > c.w;
+			}
+			outside = below || above;
+		}
+		int behind = 0;
+		for (int j = 0; j < Mesh::QUAD_FACE_VERTS; ++j) {
+			behind += clip[face[j]].w <= 1e-6f;
+		}
+		if (outside || behind == Mesh::QUAD_FACE_VERTS) {
+			faceLevels[f] = 0;
+			continue;
+		}
+		if (behind > 0) {
+			faceLevels[f] = maxLevel; // crosses the camera plane, as close as it gets
+			continue;
+		}
+
+		float pixels = 0.f;
+		for (int j = 0; j < Mesh::QUAD_FACE_VERTS; ++j) {
+			const Vec4 &a = clip[face[j]], &b = clip[face[(j + 1) & 3]];
+			const Vec2 d = 0.5f * viewport * (Vec2(a) / a.w - Vec2(b) / b.w);
+			pixels = Max(pixels, glm::length(d));
+		}
+		const int level = pixels > quadPixels ? int(std::ceil(std::log2(pixels / quadPixels))) : 0;
+		faceLevels[f] = Min(level, maxLevel);
+	}
+
+	// Finest levels go down first until the budget holds
+	for (int cap = maxLevel; cap > 0; --cap) {
+		long long triangles = 0;
+		for (int &l : faceLevels) {
+			l = Min(l, cap);
+			triangles += 2ll << (2 * l);
+		}
+		if (triangles <= maxTriangles) {
+			break;
+		}
+	}
+}
+
+PatchVertex ViewTessellation::border(int f, int j, int k, int n) const {
+	const int e = cage.faceEdges[f][j];
+	const int samples = 1 << edgeLevels[e];
+	const int kc = k / (n / samples); // the samples of the edge are a subset of those of the face
+	const bool forward = cage.edgeVerts[e].x == cageFaces[f][j];
+	return edgeSamples[e][forward ? kc : samples - kc];
+}
+
+bool ViewTessellation::update(const Vec<Vec3> &ps, const Vec<Vec4i> &faces, const LimitEvaluator &evaluator,
+	const glm::mat4 &mvp, int width, int height) {
+	if (faces != cageFaces || ps != cagePs) {
+		reset(ps, faces, evaluator);
+	}
+
+	Vec<int> faceLevels;
+	pickLevels(mvp, width, height, faceLevels);
+
+	// Edges at the lower level of their faces, a face changes with any of its edges
+	Vec<int> dirtyEdges;
+	Vec<char> edgeChanged(cage.edgeCount(), 0);
+	for (int e = 0; e < cage.edgeCount(); ++e) {
+		const Vec2i &ef = cage.edgeFaces[e];
+		const int l = ef.y < 0 ? faceLevels[ef.x] : Min(faceLevels[ef.x], faceLevels[ef.y]);
+		if (l != edgeLevels[e]) {
+			edgeLevels[e] = l;
+			edgeChanged[e] = 1;
+			dirtyEdges.push_back(e);
+		}
+	}
+	changed.clear();
+	for (int f = 0; f < int(cageFaces.size()); ++f) {
+		const Vec4i &fe = cage.faceEdges[f];
+		if (faceLevels[f] != levels[f] || edgeChanged[fe[0]] || edgeChanged[fe[1]] || edgeChanged[fe[2]] || edgeChanged[fe[3]]) {
+			levels[f] = faceLevels[f];
+			changed.push_back(f);
+		}
+	}
+	if (changed.empty()) {
+		return false;
+	}
+
+	// Inner samples of the changed edges, then inner points of the changed faces, in one batch
+	Vec<LimitQuery> queries;
+	for (int e : dirtyEdges) {
+		const int n = 1 << edgeLevels[e];
+		const int f = cage.edgeFaces[e].x;
+		int j = 0;
+		while (cage.faceEdges[f][j] != e) {
+			++j;
+		}
+		const bool forward = cage.edgeVerts[e].x == cageFaces[f][j];
+		for (int k = 1; k < n; ++k) {
+			const Vec2 uv = sideUV(j, forward ? k / float(n) : 1.f - k / float(n));
+			queries.push_back({ f, uv.x, uv.y });
+		}
+	}
+	for (int f : changed) {
+		const int n = 1 << levels[f];
+		for (int y = 1; y < n; ++y) {
+			for (int x = 1; x < n; ++x) {
+				queries.push_back({ f, x / float(n), y / float(n) });
+			}
+		}
+	}
+	Vec<Vec3> points, du, dv;
+	evaluator.evaluate(queries, points, &du, &dv);
+
+	int q = 0;
+	for (int e : dirtyEdges) {
+		const int n = 1 << edgeLevels[e];
+		Vec<PatchVertex> &samples = edgeSamples[e];
+		samples.resize(n + 1);
+		samples[0] = corners[cage.edgeVerts[e].x];
+		samples[n] = corners[cage.edgeVerts[e].y];
+		for (int k = 1; k < n; ++k, ++q) {
+			samples[k] = patchVertex(points[q], du[q], dv[q]);
+		}
+	}
+	for (int f : changed) {
+		const int n = 1 << levels[f], row = n + 1;
+		Vec<PatchVertex> &patch = patches[f];
+		resizeExact(patch, size_t(row) * row);
+		for (int y = 1; y < n; ++y) {
+			for (int x = 1; x < n; ++x, ++q) {
+				patch[y * row + x] = patchVertex(points[q], du[q], dv[q]);
+			}
+		}
+		for (int k = 0; k <= n; ++k) {
+			patch[k] = border(f, 0, k, n);
+			patch[k * row + n] = border(f, 1, k, n);
+			patch[n * row + n - k] = border(f, 2, k, n);
+			patch[(n - k) * row] = border(f, 3, k, n);
+		}
+	}
+	return true;
+}
+
+void ViewTessellation::clear() {
+	levels.clear();
+	patches.clear();
+	changed.clear();
+	cagePs.clear();
+	cageFaces.clear();
+	cage = Topology{};
+	corners.clear();
+	edgeLevels.clear();
+	edgeSamples.clear();
+}
+
+long long ViewTessellation::triangleCount() const {
+	long long triangles = 0;
+	for (int l : levels) {
+		triangles += l < 0 ? 0 : 2ll << (2 * l);
+	}
+	return triangles;
+}